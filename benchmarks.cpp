@@ -0,0 +1,510 @@
+//-*-Mode:C++;coding:utf-8;tab-width:4;c-basic-offset:4;indent-tabs-mode:()-*-
+// ex: set ft=cpp fenc=utf-8 sts=4 ts=4 sw=4 et nomod:
+
+#include "effects.hpp"
+#include "effects_memory.hpp"
+#include "effects_container.hpp"
+#include <chrono>
+#include <cstdio>
+#include <cstddef>
+#include <cstring>
+#include <vector>
+
+#if ! defined(BENCHMARKS_CONFIGURATION)
+#define BENCHMARKS_CONFIGURATION ""
+#endif
+#if defined(__clang__)
+#define BENCHMARKS_NOINLINE __attribute__((noinline))
+#elif defined(__GNUC__)
+// (noipa also prevents the constant propagation of arguments)
+#define BENCHMARKS_NOINLINE __attribute__((noipa))
+#elif defined(_MSC_VER)
+#define BENCHMARKS_NOINLINE __declspec(noinline)
+#else
+#define BENCHMARKS_NOINLINE
+#endif
+
+namespace
+{
+    std::size_t const iterations = 10000000;
+    std::size_t const context_iterations = iterations / 10;
+    std::size_t const bulk_size = 1024;
+    std::size_t const bulk_iterations = iterations / bulk_size;
+
+    // runtime values to prevent constant folding
+    volatile double numerator = 2.0;
+    volatile double denominator = 3.0;
+    volatile double exact = 0.5;
+    volatile int integer = 3;
+    int i = 1;
+    int const j = 2;
+    int * volatile pointer = &i;
+    volatile double sink = 0.0;
+    volatile int sink_integer = 0;
+    volatile bool sink_bool = false;
+    volatile unsigned int sink_kind = 0;
+    int * volatile sink_pointer = nullptr;
+
+    bool output_csv = false;
+
+    char const * compiler()
+    {
+#if defined(__clang__)
+        return "clang++ " __clang_version__;
+#elif defined(__GNUC__)
+        return "g++ " __VERSION__;
+#else
+        return "unknown";
+#endif
+    }
+
+    template <typename F>
+    double nanoseconds_per_iteration(F f,
+                                     std::size_t const count = iterations)
+    {
+        auto const start = std::chrono::steady_clock::now();
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            f();
+        }
+        auto const stop = std::chrono::steady_clock::now();
+        std::chrono::duration<double, std::nano> const elapsed = stop - start;
+        return elapsed.count() / count;
+    }
+
+    void report(char const * const name, double const nanoseconds)
+    {
+        if (output_csv)
+        {
+            std::printf("\"%s\",\"%s\",\"%s\",%.3f\n",
+                        name, compiler(), BENCHMARKS_CONFIGURATION,
+                        nanoseconds);
+        }
+        else
+        {
+            std::printf("%-48s %8.2f ns\n", name, nanoseconds);
+        }
+    }
+
+    // the context::update floating-point path before the single read
+    // of the FE_* flags (one fetestexcept call for each FE_* flag)
+    unsigned int update_multiple_reads() noexcept
+    {
+        int const fpe_all = FE_INVALID | FE_DIVBYZERO | FE_OVERFLOW |
+                            FE_UNDERFLOW | FE_INEXACT;
+        unsigned int kind = effects::kind::reference;
+        if (std::fetestexcept(fpe_all))
+        {
+            if (std::fetestexcept(FE_INVALID))
+            {
+                kind |= effects::kind::fpe | effects::kind_fpe::invalid;
+            }
+            if (std::fetestexcept(FE_DIVBYZERO))
+            {
+                kind |= effects::kind::fpe |
+                        effects::kind_fpe::divide_by_zero;
+            }
+            if (std::fetestexcept(FE_OVERFLOW))
+            {
+                kind |= effects::kind::fpe | effects::kind_fpe::overflow;
+            }
+            if (std::fetestexcept(FE_UNDERFLOW))
+            {
+                kind |= effects::kind::fpe | effects::kind_fpe::underflow;
+            }
+            if (std::fetestexcept(FE_INEXACT))
+            {
+                kind |= effects::kind::fpe | effects::kind_fpe::inexact;
+            }
+            std::feclearexcept(fpe_all);
+        }
+        return kind;
+    }
+}
+
+using namespace effects;
+
+void benchmark_regions()
+{
+    context c(kind::reference | kind::write | kind::fpe,
+              context_type::terminating);
+    report("region<int> construction",
+           nanoseconds_per_iteration([&c]() {
+        region<int> value = c(static_cast<int>(integer));
+        sink_integer = value;
+    }));
+    report("region<double> construction (no FPE)",
+           nanoseconds_per_iteration([&c]() {
+        region<double> value = c(exact * numerator);
+        sink = value;
+    }));
+    report("region<double> construction (inexact)",
+           nanoseconds_per_iteration([&c]() {
+        region<double> value = c(numerator / denominator);
+        sink = value;
+    }));
+    report("region<int *> construction",
+           nanoseconds_per_iteration([&c]() {
+        region<int *> value = c(static_cast<int *>(pointer));
+        sink_pointer = value;
+    }));
+    report("region<int &> construction",
+           nanoseconds_per_iteration([&c]() {
+        region<int &> value = c(i);
+        sink_integer = value;
+    }));
+    report("region<int const &> construction",
+           nanoseconds_per_iteration([&c]() {
+        region<int const &> value = c(j);
+        sink_integer = value;
+    }));
+    region<int> value_integer = c(1);
+    report("region<int> assignment",
+           nanoseconds_per_iteration([&value_integer]() {
+        value_integer = static_cast<int>(integer);
+        sink_integer = value_integer;
+    }));
+    region<double> value_double = c(1.0);
+    report("region<double> assignment (no FPE)",
+           nanoseconds_per_iteration([&value_double]() {
+        value_double = exact * numerator;
+        sink = value_double;
+    }));
+    report("region<double> assignment (inexact)",
+           nanoseconds_per_iteration([&value_double]() {
+        value_double = numerator / denominator;
+        sink = value_double;
+    }));
+    sink_kind = c.kind();
+
+    context c_deferred(kind::reference | kind::fpe,
+                       context_type::terminating, fpe_sampling::deferred);
+    report("region<double> construction (inexact) deferred",
+           nanoseconds_per_iteration([&c_deferred]() {
+        region<double> value = c_deferred(numerator / denominator);
+        sink = value;
+    }));
+    sink_kind = c_deferred.kind();
+
+    context c_sampled = context::sampled(
+        kind::reference | kind::fpe, context_type::terminating, 1000000);
+    report("region<double> construction (inexact) untracked",
+           nanoseconds_per_iteration([&c_sampled]() {
+        region<double> value = c_sampled(numerator / denominator);
+        sink = value;
+    }));
+    sink_kind = c_sampled.kind();
+}
+
+// a function creating a context for each call
+// (with site_regions floating-point regions)
+std::size_t const site_regions = 16;
+
+double function_context(double x)
+{
+    context c(kind::reference | kind::fpe, context_type::terminating);
+    for (std::size_t i = 0; i < site_regions; ++i)
+    {
+        region<double> value = c(x / denominator);
+        x = value;
+    }
+    sink_bool = c.valid();
+    return x;
+}
+
+double function_site(double x)
+{
+    EFFECTS_FUNCTION(c, kind::reference | kind::fpe);
+    for (std::size_t i = 0; i < site_regions; ++i)
+    {
+        region<double> value = c(x / denominator);
+        x = value;
+    }
+    sink_bool = c.valid();
+    return x;
+}
+
+void benchmark_site()
+{
+    report("function context (16 regions, inexact)",
+           nanoseconds_per_iteration([]() {
+        sink = function_context(numerator);
+    }, context_iterations));
+    report("function EFFECTS_FUNCTION (16 regions, inexact)",
+           nanoseconds_per_iteration([]() {
+        sink = function_site(numerator);
+    }, context_iterations));
+}
+
+// region conversion kernels are not inlined, so the generated code size
+// of each kernel is comparable for each configuration
+// (provided by "make bench_matrix" in the code_size_*.txt files)
+BENCHMARKS_NOINLINE double kernel_plain(double const x)
+{
+    return x * x + x;
+}
+
+BENCHMARKS_NOINLINE double kernel_region(region<double> const & x)
+{
+    double const value = x;
+    return value * value + value;
+}
+
+BENCHMARKS_NOINLINE double kernel_region_created(context & c,
+                                                 double const x)
+{
+    region<double> value = c(x * x + x);
+    return value;
+}
+
+void benchmark_conversions()
+{
+    context c(kind::reference | kind::fpe, context_type::terminating);
+    report("kernel double",
+           nanoseconds_per_iteration([]() {
+        sink = kernel_plain(exact);
+    }));
+    region<double> value = c(static_cast<double>(exact));
+    report("kernel region<double> conversion",
+           nanoseconds_per_iteration([&value]() {
+        sink = kernel_region(value);
+    }));
+    report("kernel region<double> construction",
+           nanoseconds_per_iteration([&c]() {
+        sink = kernel_region_created(c, exact);
+    }));
+    sink_kind = c.kind();
+}
+
+// a function that is not noexcept (not inlined, so it may throw)
+BENCHMARKS_NOINLINE int integer_may_throw(int const x)
+{
+    if (x < 0)
+    {
+        throw x;
+    }
+    return x;
+}
+
+void benchmark_context()
+{
+    report("context construction",
+           nanoseconds_per_iteration([]() {
+        context c(kind::reference, context_type::terminating);
+        sink_kind = c.kind();
+    }, context_iterations));
+    report("context::sampled construction (untracked)",
+           nanoseconds_per_iteration([]() {
+        context c = context::sampled(kind::reference,
+                                     context_type::terminating, 1000000);
+        sink_kind = c.kind();
+    }, context_iterations));
+    context c(kind::reference | kind::fpe, context_type::terminating);
+    report("context::child construction and join",
+           nanoseconds_per_iteration([&c]() {
+        child_context c_child = c.child(kind::reference);
+        sink_kind = c_child.kind();
+    }));
+    report("context::clear",
+           nanoseconds_per_iteration([&c]() {
+        c.clear();
+    }, context_iterations));
+    report("context::valid (no FPE)",
+           nanoseconds_per_iteration([&c]() {
+        sink_bool = c.valid();
+    }));
+    report("context::valid (inexact)",
+           nanoseconds_per_iteration([&c]() {
+        sink = numerator / denominator;
+        sink_bool = c.valid();
+    }));
+    report("context::kind",
+           nanoseconds_per_iteration([&c]() {
+        sink_kind = c.kind();
+    }));
+    report("context::is_pure",
+           nanoseconds_per_iteration([&c]() {
+        sink_bool = c.is_pure();
+    }));
+    report("context::has_reference",
+           nanoseconds_per_iteration([&c]() {
+        sink_bool = c.has_reference();
+    }));
+    report("context::has_fpe",
+           nanoseconds_per_iteration([&c]() {
+        sink_bool = c.has_fpe();
+    }));
+    report("context::dispatch (fast)",
+           nanoseconds_per_iteration([&c]() {
+        region<double> value = c.dispatch(
+            []() { return exact * numerator; },
+            []() { return exact * numerator; });
+        sink = value;
+    }));
+    report("context::dispatch (safe)",
+           nanoseconds_per_iteration([&c]() {
+        region<double> value = c.dispatch(
+            []() { return numerator / denominator; },
+            []() { return exact * numerator; });
+        sink = value;
+    }));
+    report("function call (may throw)",
+           nanoseconds_per_iteration([]() {
+        sink_integer = integer_may_throw(integer);
+    }));
+    report("guarded function call (may throw)",
+           nanoseconds_per_iteration([&c]() {
+        sink_integer = guarded(c, []() {
+            return integer_may_throw(integer);
+        });
+    }));
+}
+
+void benchmark_fpe()
+{
+    context c(kind::reference | kind::fpe, context_type::terminating);
+    report("FPE capture (no FPE) multiple reads",
+           nanoseconds_per_iteration([]() {
+        sink = exact * numerator;
+        sink_kind = update_multiple_reads();
+    }));
+    report("FPE capture (no FPE) single read",
+           nanoseconds_per_iteration([&c]() {
+        region<double> value = c(exact * numerator);
+        sink = value;
+    }));
+    report("FPE capture (inexact) multiple reads",
+           nanoseconds_per_iteration([]() {
+        sink = numerator / denominator;
+        sink_kind = update_multiple_reads();
+    }));
+    report("FPE capture (inexact) single read",
+           nanoseconds_per_iteration([&c]() {
+        region<double> value = c(numerator / denominator);
+        sink = value;
+    }));
+    sink_kind = c.kind();
+}
+
+void benchmark_memory()
+{
+    memory::install();
+    context c(kind::reference | kind::write, context_type::terminating);
+    int * const heap = new int(1);
+    report("region<int *> classified (heap)",
+           nanoseconds_per_iteration([&c, heap]() {
+        region<int *> value = c(static_cast<int *>(heap));
+        sink_pointer = value;
+    }));
+    report("region<int *> classified (static data)",
+           nanoseconds_per_iteration([&c]() {
+        region<int *> value = c(static_cast<int *>(pointer));
+        sink_pointer = value;
+    }));
+    char const * volatile literal = "read-only";
+    report("region<char const *> classified (read-only)",
+           nanoseconds_per_iteration([&c, &literal]() {
+        region<char const *> value = c(static_cast<char const *>(literal));
+        sink_bool = value != nullptr;
+    }));
+    memory_classifier.store(nullptr);
+    sink_kind = c.kind();
+    delete heap;
+}
+
+void benchmark_containers()
+{
+    context c(kind::reference | kind::write | kind::exception,
+              context_type::terminating);
+    std::vector<int> plain;
+    plain.reserve(bulk_size);
+    report("std::vector<int> push_back (reserved)",
+           nanoseconds_per_iteration([&plain]() {
+        plain.clear();
+        for (std::size_t i = 0; i < bulk_size; ++i)
+        {
+            plain.push_back(static_cast<int>(integer));
+        }
+    }, bulk_iterations) / bulk_size);
+    region_vector<int> values(c);
+    values.reserve(bulk_size);
+    report("region_vector<int> push_back (reserved)",
+           nanoseconds_per_iteration([&values]() {
+        values.clear();
+        for (std::size_t i = 0; i < bulk_size; ++i)
+        {
+            values.push_back(static_cast<int>(integer));
+        }
+    }, bulk_iterations) / bulk_size);
+    region_map<int, int> values_map(c);
+    values_map.emplace(static_cast<int>(integer), 0);
+    report("region_map<int, int> modify",
+           nanoseconds_per_iteration([&values_map]() {
+        sink_bool = values_map.modify(static_cast<int>(integer),
+                                      [](int & value) noexcept { ++value; });
+    }));
+    sink_integer = plain.back() + values.data()[0];
+    sink_kind = c.kind();
+}
+
+void benchmark_loops()
+{
+    // x = 2.0 / x remains inexact for each iteration
+    // (results are reported for each element)
+    std::vector<double> values(bulk_size, 3.0);
+    double const dividend = numerator;
+    report("loop raw baseline",
+           nanoseconds_per_iteration([&values, dividend]() {
+        for (double & x : values)
+        {
+            x = dividend / x;
+        }
+    }, bulk_iterations) / bulk_size);
+    sink = values[0];
+    context c(kind::reference | kind::fpe, context_type::terminating);
+    report("loop region<double>",
+           nanoseconds_per_iteration([&c, &values, dividend]() {
+        for (double & x : values)
+        {
+            region<double> value = c(dividend / x);
+            x = value;
+        }
+    }, bulk_iterations) / bulk_size);
+    context c_deferred(kind::reference | kind::fpe,
+                       context_type::terminating, fpe_sampling::deferred);
+    report("loop region<double> deferred",
+           nanoseconds_per_iteration([&c_deferred, &values, dividend]() {
+        for (double & x : values)
+        {
+            region<double> value = c_deferred(dividend / x);
+            x = value;
+        }
+        c_deferred.sample();
+    }, bulk_iterations) / bulk_size);
+    region_span<double> span = c.span(values);
+    report("loop region_span<double> transform",
+           nanoseconds_per_iteration([&span, dividend]() {
+        span.transform([dividend](double const x) { return dividend / x; });
+    }, bulk_iterations) / bulk_size);
+    sink_kind = c.kind() | c_deferred.kind();
+}
+
+int main(int argc, char ** argv)
+{
+    // "./benchmarks csv" provides machine-readable output
+    if (argc > 1 && std::strcmp(argv[1], "csv") == 0)
+    {
+        output_csv = true;
+        std::printf("\"name\",\"compiler\",\"configuration\","
+                    "\"nanoseconds\"\n");
+    }
+    benchmark_regions();
+    benchmark_context();
+    benchmark_site();
+    benchmark_conversions();
+    benchmark_fpe();
+    benchmark_memory();
+    benchmark_containers();
+    benchmark_loops();
+    return 0;
+}
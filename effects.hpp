@@ -29,7 +29,26 @@
 
 #include <utility>
 #include <type_traits>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <atomic>
+#include <new>
+#include <optional>
 #include <cfenv>
+#if __has_include(<memory_resource>)
+#include <memory_resource>
+#define EFFECTS_PMR
+#endif
+#if defined(EFFECTS_TRACE)
+#include <chrono>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+#if __has_include(<source_location>)
+#include <source_location>
+#endif
+#endif
 
 namespace effects
 {
@@ -43,50 +62,82 @@ enum struct context_type
     nonterminating
 };
 
+enum struct fpe_sampling
+{
+    // The FE_* flags are read each time a floating-point region is
+    // created or assigned, so any Floating-Point Exceptions (FPE) are
+    // attributed to the region value
+    eager,
+    // The FE_* flags are only read when the context is checked
+    // (with valid, kind, is_pure, the has_* functions or sample).
+    // The FE_* flags are sticky, so any FPE remains detected, though
+    // the FPE are attributed to all floating-point use since the
+    // last check (including floating-point use outside of regions)
+    deferred
+};
+
 namespace kind
 {
     // All possible effects in C++
-    enum
-    {
-        pure                = 0x0000, // mathematical purity
-        nonterminating      = 0x0001, // execution may not terminate
-        exception           = 0x0002, // throw/(signal)/exit/abort
-        reference           = 0x0004, // reference to global data not owned
-        write               = 0x0008, // write to global (heap) data owned
-        fpe                 = 0x0010, // Floating-Point Exceptions (FPE)
-        variation_os        = 0x0020, // Operating System (OS) variation
-        variation_hardware  = 0x0040, // hardware variation
-        bitmask             = 0x00ff
-    };
+    // (unsigned int constants, so kind and kind_fpe bits can be combined)
+    inline constexpr unsigned int pure = 0x0000; // mathematical purity
+    // execution may not terminate
+    inline constexpr unsigned int nonterminating = 0x0001;
+    // throw/(signal)/exit/abort
+    inline constexpr unsigned int exception = 0x0002;
+    // reference to global data not owned
+    inline constexpr unsigned int reference = 0x0004;
+    // write to global (heap) data owned
+    inline constexpr unsigned int write = 0x0008;
+    // Floating-Point Exceptions (FPE)
+    inline constexpr unsigned int fpe = 0x0010;
+    // Operating System (OS) variation
+    inline constexpr unsigned int variation_os = 0x0020;
+    // hardware variation
+    inline constexpr unsigned int variation_hardware = 0x0040;
+    inline constexpr unsigned int bitmask = 0x00ff;
 }
 
 namespace kind_fpe
 {
     // All possible cross-platform Floating-Point Exceptions (FPE)
-    enum
-    {
-        none                = 0x0000,
-        invalid             = 0x0100,
-        divide_by_zero      = 0x0400,
-        overflow            = 0x0800,
-        underflow           = 0x1000,
-        inexact             = 0x2000,
-        bitmask             = 0xff00
-    };
+    inline constexpr unsigned int none = 0x0000;
+    inline constexpr unsigned int invalid = 0x0100;
+    inline constexpr unsigned int divide_by_zero = 0x0400;
+    inline constexpr unsigned int overflow = 0x0800;
+    inline constexpr unsigned int underflow = 0x1000;
+    inline constexpr unsigned int inexact = 0x2000;
+    inline constexpr unsigned int bitmask = 0xff00;
 }
 
+// all the kind and kind_fpe bits
+inline constexpr unsigned int kind_mask_all =
+    kind::bitmask | kind_fpe::bitmask;
+
 class context;
+template <unsigned int KindValid, context_type Type> class static_context;
+class current_context;
+class child_context;
+class arena;
+template <typename T, typename Allocator> class region_vector;
+template <typename Key, typename T, typename Compare, typename Allocator>
+class region_map;
+
+template <typename T, typename Context = context> class region;
 
 // container for kind::write effects
-template <typename T> class region
+template <typename T, typename Context> class region
 {
     private:
         static_assert(! std::is_reference<T>::value,
                       "Do not use a reference type");
 
-        friend class context;
-        constexpr region(context & c, T && value) noexcept;
-        constexpr region(context & c, T const & value) noexcept;
+        friend Context;
+        constexpr region(Context & c, T && value) noexcept;
+        constexpr region(Context & c, T const & value) noexcept;
+        template <typename... Args>
+        constexpr region(Context & c, std::in_place_t,
+                         Args &&... args) noexcept;
 
     public:
         constexpr region(region && o) noexcept = default;
@@ -100,20 +151,28 @@ template <typename T> class region
         {
             return std::move(m_value);
         }
-        constexpr region<T> & operator = (T && rhs) noexcept;
-        constexpr region<T> & operator = (region<T> const & rhs) noexcept;
+        constexpr region & operator = (T && rhs) noexcept;
+        constexpr region & operator = (T const & rhs) noexcept;
+        constexpr region & operator = (region && rhs) noexcept;
+        constexpr region & operator = (region const & rhs) noexcept;
+
+        // move the value out of the region
+        [[nodiscard]] constexpr T take() noexcept
+        {
+            return std::move(m_value);
+        }
 
     private:
-        context & m_context;
+        Context & m_context;
         T m_value;
 };
 
 // container for constant values
-template <typename T> class region<T const &>
+template <typename T, typename Context> class region<T const &, Context>
 {
     private:
-        friend class context;
-        constexpr region(context & c, T const & value) noexcept;
+        friend Context;
+        constexpr region(Context & c, T const & value) noexcept;
 
     public:
         constexpr region(region const & o) noexcept = default;
@@ -124,16 +183,16 @@ template <typename T> class region<T const &>
         }
 
     private:
-        context & m_context;
+        Context & m_context;
         T const & m_constant;
 };
 
 // container for kind::reference effects
-template <typename T> class region<T &>
+template <typename T, typename Context> class region<T &, Context>
 {
     private:
-        friend class context;
-        constexpr region(context & c, T & value) noexcept;
+        friend Context;
+        constexpr region(Context & c, T & value) noexcept;
 
     public:
         constexpr region(region const & o) noexcept = default;
@@ -146,13 +205,219 @@ template <typename T> class region<T &>
         {
             return std::move(m_reference);
         }
-        constexpr region<T &> & operator = (T && rhs) noexcept;
+        constexpr region & operator = (T && rhs) noexcept;
+        constexpr region & operator = (T const & rhs) noexcept;
+
+    private:
+        Context & m_context;
+        T & m_reference;
+};
+
+// container for kind::write effects using the current context
+// (sizeof(T) without a context reference for a trivially copyable layout
+//  with region assignment not tracked, since the rhs region was tracked;
+//  a region that outlives the current_context scope is not tracked
+//  without a current context)
+template <typename T> class region<T, current_context>
+{
+    private:
+        static_assert(! std::is_reference<T>::value,
+                      "Do not use a reference type");
+
+        friend class current_context;
+        region(T && value) noexcept;
+        region(T const & value) noexcept;
+        template <typename... Args>
+        region(std::in_place_t, Args &&... args) noexcept;
+
+    public:
+        constexpr region(region && o) noexcept = default;
+        constexpr region(region const & o) noexcept = default;
+
+        [[nodiscard]] constexpr operator T const & () const & noexcept
+        {
+            return m_value;
+        }
+        [[nodiscard]] constexpr operator T && () && noexcept
+        {
+            return std::move(m_value);
+        }
+        region & operator = (T && rhs) noexcept;
+        region & operator = (T const & rhs) noexcept;
+        constexpr region & operator = (region && rhs) noexcept = default;
+        constexpr region & operator = (region const & rhs) noexcept = default;
+
+        // move the value out of the region
+        [[nodiscard]] constexpr T take() noexcept
+        {
+            return std::move(m_value);
+        }
+
+    private:
+        T m_value;
+};
+
+// container for constant values using the current context
+template <typename T> class region<T const &, current_context>
+{
+    private:
+        friend class current_context;
+        region(T const & value) noexcept;
+
+    public:
+        constexpr region(region const & o) noexcept = default;
+
+        [[nodiscard]] constexpr operator T const & () const noexcept
+        {
+            return m_constant;
+        }
+
+    private:
+        T const & m_constant;
+};
+
+// container for kind::reference effects using the current context
+template <typename T> class region<T &, current_context>
+{
+    private:
+        friend class current_context;
+        region(T & value) noexcept;
+
+    public:
+        constexpr region(region const & o) noexcept = default;
+
+        [[nodiscard]] constexpr operator T const & () const noexcept
+        {
+            return m_reference;
+        }
+        [[nodiscard]] constexpr operator T && () && noexcept
+        {
+            return std::move(m_reference);
+        }
+        region & operator = (T && rhs) noexcept;
+        region & operator = (T const & rhs) noexcept;
 
     private:
-        context & m_context;
         T & m_reference;
 };
 
+// container for kind::reference effects of contiguous data not owned
+// (effects are tracked once for each bulk operation instead of
+//  for each element)
+template <typename T> class region_span
+{
+    private:
+        static_assert(! std::is_reference<T>::value,
+                      "Do not use a reference type");
+
+        friend class context;
+        region_span(context & c, T * data, std::size_t size) noexcept;
+
+    public:
+        region_span(region_span const & o) noexcept = default;
+
+        [[nodiscard]] T const * data() const noexcept
+        {
+            return m_data;
+        }
+        [[nodiscard]] std::size_t size() const noexcept
+        {
+            return m_size;
+        }
+        [[nodiscard]] T const * begin() const noexcept
+        {
+            return m_data;
+        }
+        [[nodiscard]] T const * end() const noexcept
+        {
+            return m_data + m_size;
+        }
+        [[nodiscard]] T const & operator [](std::size_t const i)
+            const noexcept
+        {
+            return m_data[i];
+        }
+
+        // element-wise in-place element = f(element)
+        template <typename F>
+        void transform(F f) noexcept;
+
+        // element-wise element = *(first++)
+        template <typename InputIt>
+        void assign(InputIt first) noexcept;
+        void assign(T const & value) noexcept;
+
+        // result = f(result, element) with result = init initially
+        template <typename R, typename F>
+        [[nodiscard]] region<R> reduce(R init, F f) noexcept;
+
+    private:
+        context & m_context;
+        T * const m_data;
+        std::size_t const m_size;
+};
+
+// container for kind::write effects of N values
+// (effects are tracked once for each bulk operation instead of
+//  for each element)
+template <typename T, std::size_t N> class region_array
+{
+    private:
+        static_assert(! std::is_reference<T>::value,
+                      "Do not use a reference type");
+
+        friend class context;
+        region_array(context & c, std::array<T, N> && values) noexcept;
+        region_array(context & c, std::array<T, N> const & values) noexcept;
+
+    public:
+        region_array(region_array && o) noexcept = default;
+        region_array(region_array const & o) noexcept = default;
+
+        [[nodiscard]] operator std::array<T, N> const & () const & noexcept
+        {
+            return m_values;
+        }
+        [[nodiscard]] T const * data() const noexcept
+        {
+            return m_values.data();
+        }
+        [[nodiscard]] static constexpr std::size_t size() noexcept
+        {
+            return N;
+        }
+        [[nodiscard]] T const * begin() const noexcept
+        {
+            return m_values.data();
+        }
+        [[nodiscard]] T const * end() const noexcept
+        {
+            return m_values.data() + N;
+        }
+        [[nodiscard]] T const & operator [](std::size_t const i)
+            const noexcept
+        {
+            return m_values[i];
+        }
+
+        // element-wise in-place element = f(element)
+        template <typename F>
+        void transform(F f) noexcept;
+
+        // element-wise element = *(first++)
+        template <typename InputIt>
+        void assign(InputIt first) noexcept;
+        void assign(T const & value) noexcept;
+
+        // result = f(result, element) with result = init initially
+        template <typename R, typename F>
+        [[nodiscard]] region<R> reduce(R init, F f) noexcept;
+
+    private:
+        context & m_context;
+        std::array<T, N> m_values;
+};
+
 #if __cplusplus >= 202002L
 #define CXX20
 #endif
@@ -171,6 +436,70 @@ struct identity
 #else
 #error "C++17 or higher is required"
 #endif
+// true during constant evaluation, so the floating-point environment
+// is not used in a constant expression
+[[nodiscard]] constexpr bool is_constant_evaluated() noexcept
+{
+#if defined(CXX20)
+    return std::is_constant_evaluated();
+#else
+    return __builtin_is_constant_evaluated();
+#endif
+}
+// an optimization barrier that requires the value is computed
+// (raising any floating-point exceptions) before the barrier,
+// so the floating-point environment is tested after the computation
+// with all compilers and optimization levels
+template <typename T>
+inline void barrier(T const & value) noexcept
+{
+#if defined(__GNUC__)
+    if constexpr (std::is_integral_v<T> || std::is_pointer_v<T>)
+    {
+        asm volatile("" : : "r,m"(value) : "memory");
+    }
+#if defined(__SSE2__)
+    else if constexpr (std::is_same_v<T, float> || std::is_same_v<T, double>)
+    {
+        asm volatile("" : : "x,m"(value) : "memory");
+    }
+#endif
+    else
+    {
+        asm volatile("" : : "m"(value) : "memory");
+    }
+#else
+    // the address escapes, so the value is stored before the barrier
+    static void const * volatile escaped = nullptr;
+    escaped = &value;
+#endif
+}
+// a value the optimizer can not see through, so a computation using
+// the value is not constant folded (removing floating-point exceptions)
+template <typename T>
+[[nodiscard]] inline T opaque(T value) noexcept
+{
+#if defined(__GNUC__)
+    if constexpr (std::is_integral_v<T> || std::is_pointer_v<T>)
+    {
+        asm volatile("" : "+r"(value) : : "memory");
+    }
+#if defined(__SSE2__)
+    else if constexpr (std::is_same_v<T, float> || std::is_same_v<T, double>)
+    {
+        asm volatile("" : "+x"(value) : : "memory");
+    }
+#endif
+    else
+    {
+        asm volatile("" : "+m"(value) : : "memory");
+    }
+    return value;
+#else
+    T * volatile pointer = &value;
+    return *pointer;
+#endif
+}
 template <typename T>
 struct remove_all_pointers : std::conditional_t<
     std::is_pointer_v<T>,
@@ -180,325 +509,2243 @@ struct remove_all_pointers : std::conditional_t<
 {};
 template <typename T>
 using remove_all_pointers_t = typename remove_all_pointers<T>::type;
+// customization point for floating-point types that are not
+// std::is_floating_point types, like SIMD vector types
+// (specializations are provided by effects_simd.hpp)
+template <typename T>
+struct is_floating_point_pack : std::false_type
+{};
 template <typename T>
-using is_floating_point = std::is_floating_point< remove_all_pointers_t<T> >;
+struct is_floating_point : std::bool_constant<
+    std::is_floating_point_v< remove_all_pointers_t<T> > ||
+    is_floating_point_pack< remove_all_pointers_t<T> >::value
+>
+{};
 
-class context
+// customization point for pointer ownership classification
+// (true if the memory is owned global data, i.e., a kind::write effect,
+//  with effects_memory.hpp providing a classifier using address ranges)
+using memory_classifier_t = bool (*)(void const *) noexcept;
+inline std::atomic<memory_classifier_t> memory_classifier{nullptr};
+
+// type-derived variation effects for types with a size (or representation)
+// that depends on the environment, e.g., wchar_t is 16 bits with Windows
+// and long double is 80 bits with x87 but 64 bits (or 128 bits) elsewhere
+// (a customization point, with EFFECTS_VARIATION_TYPES defined as 0 to
+//  disable the specializations).  long (32 bits with 32-bit architectures)
+// is only a variation_hardware effect (see set_variation_hardware) if
+// EFFECTS_VARIATION_LONG is defined, since std::size_t, std::int64_t and
+// std::uint64_t are long with LP64.
+#if ! defined(EFFECTS_VARIATION_TYPES)
+#define EFFECTS_VARIATION_TYPES 1
+#endif
+template <typename T>
+struct kind_variation : std::integral_constant<unsigned int, kind::pure>
+{};
+#if EFFECTS_VARIATION_TYPES
+#if defined(EFFECTS_VARIATION_LONG)
+template <>
+struct kind_variation<long> :
+    std::integral_constant<unsigned int, kind::variation_hardware>
+{};
+template <>
+struct kind_variation<unsigned long> :
+    std::integral_constant<unsigned int, kind::variation_hardware>
+{};
+#endif
+template <>
+struct kind_variation<wchar_t> :
+    std::integral_constant<unsigned int, kind::variation_os>
+{};
+template <>
+struct kind_variation<long double> :
+    std::integral_constant<unsigned int, kind::variation_hardware>
+{};
+#endif
+
+// variation effects of floating-point use in this process
+// (e.g., kind::variation_hardware if flush-to-zero is enabled,
+//  with effects_environment.hpp providing the value from a probe)
+inline std::atomic<unsigned int> floating_point_variation{kind::pure};
+
+#if defined(EFFECTS_TRACE)
+// effect provenance log with EFFECTS_TRACE defined
+// (the records are stored in a preallocated ring buffer)
+#if ! defined(EFFECTS_TRACE_SIZE)
+#define EFFECTS_TRACE_SIZE 16
+#endif
+#if defined(__cpp_lib_source_location)
+using trace_location = std::source_location;
+#else
+class trace_location
 {
     public:
-        constexpr context(unsigned int const kind_valid,
-                          context_type const type) noexcept :
-            m_kind_invalid((~kind_valid) & kind::bitmask),
-            m_kind(kind::pure)
+        static constexpr trace_location current(
+            char const * const file_name = __builtin_FILE(),
+            char const * const function_name = __builtin_FUNCTION(),
+            unsigned int const line = __builtin_LINE()) noexcept
         {
-            if (type == context_type::nonterminating)
-            {
-                m_kind |= kind::nonterminating;
-            }
-            std::feclearexcept(context::fpe_all);
+            return trace_location(file_name, function_name, line);
         }
-        constexpr context(context const & o) noexcept = delete;
-
-        template <typename T>
-        [[nodiscard]] constexpr region<T> operator ()(T && t) noexcept
+        constexpr trace_location() noexcept :
+            trace_location("", "", 0)
         {
-            return region<T>(*this, std::forward<T>(t));
         }
 
-        constexpr void set_exception() noexcept
+        [[nodiscard]] constexpr char const * file_name() const noexcept
         {
-            // An exception was thrown, an unignored signal was raised or
-            // execution will terminate with a function call
-            // (like exit or abort).  Throwing an exception can be pure
-            // because it doesn't interfere with referential transparency,
-            // though throwing an exception is tracked as an effect due to the
-            // need to catch the exception.
-            //
-            // Regarding stdlib.h:
-            // If the exit function was called, it operates like an exception
-            // was thrown.  If the atexit function
-            // (or the deprecated on_exit function) was called, it operates
-            // like catch.
-            // If the abort function was called, it operates like an exception
-            // was thrown.  If a signal handler exists for the SIGABRT signal,
-            // the signal handler would operate like catch.
-            //
-            // Regarding setjmp.h:
-            // If the setjmp function was called, it operates like catch.
-            // All longjmp function calls would be tracked as exceptions with
-            // the setjmp function preventing referential transparency
-            // (with the assumption that its saved calling environment
-            //  information is used due to a longjmp function call).
-            //
-            // Regarding ucontext.h:
-            // If the setcontext function or the swapcontext function was
-            // called, it operates like catch.  All ucontext_t data created
-            // with getcontext and modified with makecontext would be
-            // tracked as exceptions with the setcontext/swapcontext function
-            // preventing referential transparency
-            // (with the assumption that all ucontext_t data is used).
-            m_kind |= kind::exception;
+            return m_file_name;
         }
-
-        constexpr void set_variation_os() noexcept
+        [[nodiscard]] constexpr char const * function_name() const noexcept
         {
-            // Execution will vary due to the Operating System (OS) used,
-            // preventing the functionality from being mathematically pure.
-            // A filepath function that uses '/' characters on UNIX and
-            // '\\' on Windows for its return value is an example of
-            // kind::variation_os .
-            m_kind |= kind::variation_os;
+            return m_function_name;
         }
-
-        constexpr void set_variation_hardware() noexcept
+        [[nodiscard]] constexpr unsigned int line() const noexcept
         {
-            // Execution will vary due to the hardware used,
-            // preventing the functionality from being mathematically pure.
-            // Usage of a long type on both a 32-bit architecture and a
-            // 64-bit architecture can cause a function return value
-            // to have different possible return value limitations and
-            // is an example of kind::variation_hardware .
-            m_kind |= kind::variation_hardware;
+            return m_line;
         }
 
-        void clear() noexcept
+    private:
+        constexpr trace_location(char const * const file_name,
+                                 char const * const function_name,
+                                 unsigned int const line) noexcept :
+            m_file_name(file_name),
+            m_function_name(function_name),
+            m_line(line)
         {
-            m_kind = kind::pure;
-            std::feclearexcept(context::fpe_all);
         }
 
-        [[nodiscard]] bool valid() noexcept
+        char const * m_file_name;
+        char const * m_function_name;
+        unsigned int m_line;
+};
+#endif
+
+struct trace_record
+{
+    // the kind bit added
+    unsigned int kind = 0;
+    // the most recent context::operator() or context::make call
+    trace_location location;
+    // the TSC (x86) or std::chrono::steady_clock time
+    std::uint64_t timestamp = 0;
+};
+
+class trace_log
+{
+    public:
+        static constexpr std::size_t capacity = EFFECTS_TRACE_SIZE;
+        static_assert((capacity & (capacity - 1)) == 0 && capacity > 0,
+                      "EFFECTS_TRACE_SIZE must be a power of 2");
+
+        constexpr trace_log() noexcept :
+            m_records(),
+            m_count(0)
         {
-            update();
-            return (m_kind_invalid & m_kind) == 0;
         }
 
-        [[nodiscard]] unsigned int kind() const noexcept
+        [[nodiscard]] std::size_t size() const noexcept
         {
-            return m_kind;
+            return m_count < capacity ? m_count : capacity;
         }
 
-        [[nodiscard]] bool is_pure() noexcept
+        [[nodiscard]] std::size_t dropped() const noexcept
+        {
+            // the number of oldest records overwritten
+            return m_count - size();
+        }
+
+        [[nodiscard]] trace_record const & operator [](std::size_t const i)
+            const noexcept
+        {
+            // oldest record first
+            return m_records[(dropped() + i) & (capacity - 1)];
+        }
+
+        void clear() noexcept
+        {
+            m_count = 0;
+        }
+
+    private:
+        friend class context;
+
+        void append(unsigned int const kind,
+                    trace_location const & location,
+                    std::uint64_t const timestamp) noexcept
+        {
+            trace_record & record = m_records[m_count & (capacity - 1)];
+            record.kind = kind;
+            record.location = location;
+            record.timestamp = timestamp;
+            ++m_count;
+        }
+
+        std::array<trace_record, capacity> m_records;
+        std::size_t m_count;
+};
+#else
+// empty when EFFECTS_TRACE is not defined
+class trace_location
+{
+    public:
+        static constexpr trace_location current() noexcept
+        {
+            return trace_location();
+        }
+};
+#endif
+
+// container for a value computed when the value is first used
+// (effects are tracked when the thunk is called)
+template <typename F> class lazy_region
+{
+    public:
+        using value_type = std::decay_t< std::invoke_result_t<F &> >;
+
+    private:
+        static_assert(! std::is_void<value_type>::value,
+                      "The thunk must return a value");
+
+        friend class context;
+        lazy_region(context & c, F f,
+                    trace_location const & location) noexcept;
+
+    public:
+        lazy_region(lazy_region && o) noexcept = default;
+        lazy_region(lazy_region const & o) = delete;
+
+        [[nodiscard]] operator value_type const & () const &
+        {
+            return get();
+        }
+
+        // call the thunk if it was not yet called
+        [[nodiscard]] value_type const & get() const;
+
+        [[nodiscard]] bool forced() const noexcept
+        {
+            return m_value.has_value();
+        }
+
+    private:
+        context & m_context;
+        mutable F m_thunk;
+        mutable std::optional<value_type> m_value;
+        trace_location m_location;
+};
+
+// monotonic buffer for context allocations
+// (memory allocated from the arena of a context is owned by the context
+//  instead of being global (heap) data, so it is not a kind::write effect,
+//  and all the allocations are released when the context is cleared or
+//  the arena is destroyed)
+class arena
+#if defined(EFFECTS_PMR)
+    : public std::pmr::memory_resource
+#endif
+{
+    public:
+        arena(context & c, void * const buffer,
+              std::size_t const size) noexcept;
+        arena(arena const & o) noexcept = delete;
+        ~arena() noexcept;
+
+        [[nodiscard]] void * try_allocate(std::size_t const size,
+                                          std::size_t const alignment) noexcept
+        {
+            // nullptr if the arena is exhausted
+            std::uintptr_t const base =
+                reinterpret_cast<std::uintptr_t>(m_buffer);
+            std::uintptr_t const p =
+                (base + m_used + alignment - 1) & ~(alignment - 1);
+            if (p - base > m_size || size > m_size - (p - base))
+            {
+                return nullptr;
+            }
+            m_used = (p - base) + size;
+            return reinterpret_cast<void *>(p);
+        }
+
+        void release() noexcept
+        {
+            m_used = 0;
+        }
+
+        [[nodiscard]] bool contains(void const * const p) const noexcept
+        {
+            std::uintptr_t const base =
+                reinterpret_cast<std::uintptr_t>(m_buffer);
+            return reinterpret_cast<std::uintptr_t>(p) - base < m_size;
+        }
+
+        // the context the arena is attached to
+        // (only the owner releases the arena allocations when cleared)
+        [[nodiscard]] context const & owner() const noexcept
+        {
+            return m_context;
+        }
+
+        [[nodiscard]] std::size_t used() const noexcept
+        {
+            return m_used;
+        }
+
+        [[nodiscard]] std::size_t size() const noexcept
+        {
+            return m_size;
+        }
+
+#if defined(EFFECTS_PMR)
+    private:
+        void * do_allocate(std::size_t const size,
+                           std::size_t const alignment) override
+        {
+            void * const p = try_allocate(size, alignment);
+            if (p == nullptr)
+            {
+                throw std::bad_alloc();
+            }
+            return p;
+        }
+
+        void do_deallocate(void *, std::size_t, std::size_t) override
+        {
+            // monotonic, memory is only released with release
+        }
+
+        bool do_is_equal(std::pmr::memory_resource const & o)
+            const noexcept override
+        {
+            return this == &o;
+        }
+#endif
+
+    private:
+        context & m_context;
+        arena * const m_previous;
+        unsigned char * const m_buffer;
+        std::size_t const m_size;
+        std::size_t m_used;
+};
+
+// context counters with EFFECTS_STATISTICS defined
+struct context_statistics
+{
+    // region<T> (or region_array<T, N>) creations
+    std::uint64_t values = 0;
+    // region<T const &> creations
+    std::uint64_t constants = 0;
+    // region<T &> (or region_span<T>) creations
+    std::uint64_t references = 0;
+    // region assignments (or region_array/region_span modifications)
+    std::uint64_t assignments = 0;
+    // FE_* flags reads (fetestexcept calls)
+    std::uint64_t fpe_reads = 0;
+    // FE_* flags reads with flags set
+    std::uint64_t fpe_reads_set = 0;
+    // FE_* flags clears (feclearexcept calls)
+    std::uint64_t fpe_clears = 0;
+    // dispatch calls that used the safe function
+    std::uint64_t dispatch_fallbacks = 0;
+    // region_vector/region_map storage allocations
+    std::uint64_t allocations = 0;
+};
+
+// counters of the contexts tracked by context::sampled
+// (shared by all threads and only modified by the tracked contexts,
+//  so the totals are estimated by multiplying with the sampling rate)
+struct sampling_telemetry
+{
+    // tracked contexts
+    std::atomic<std::uint64_t> tracked{0};
+    // tracked contexts checked with valid (once for each context)
+    std::atomic<std::uint64_t> checked{0};
+    // checked contexts that were not valid
+    std::atomic<std::uint64_t> invalid{0};
+    // checked contexts that were not valid for each effect bit
+    // (index i is the kind or kind_fpe bit (1 << i))
+    std::array<std::atomic<std::uint64_t>, 16> invalid_kind{};
+};
+inline sampling_telemetry telemetry;
+
+// the effects that are not valid, including the kind_fpe bits
+// (kind::fpe without kind_fpe bits makes all FPE valid and
+//  kind_fpe bits make only those FPE valid)
+[[nodiscard]] constexpr unsigned int kind_invalid(
+    unsigned int const kind_valid) noexcept
+{
+    unsigned int valid = kind_valid & kind::bitmask;
+    if (kind_valid & kind_fpe::bitmask)
+    {
+        valid |= kind::fpe | (kind_valid & kind_fpe::bitmask);
+    }
+    else if (kind_valid & kind::fpe)
+    {
+        valid |= kind_fpe::bitmask;
+    }
+    return (~valid) & kind_mask_all;
+}
+
+// the FE_* flags of kind_fpe bits
+[[nodiscard]] constexpr int fpe_flags(unsigned int const kind) noexcept
+{
+    int flags = 0;
+#ifdef FE_INVALID
+    if (kind & kind_fpe::invalid)
+    {
+        flags |= FE_INVALID;
+    }
+#endif
+#ifdef FE_DIVBYZERO
+    if (kind & kind_fpe::divide_by_zero)
+    {
+        flags |= FE_DIVBYZERO;
+    }
+#endif
+#ifdef FE_OVERFLOW
+    if (kind & kind_fpe::overflow)
+    {
+        flags |= FE_OVERFLOW;
+    }
+#endif
+#ifdef FE_UNDERFLOW
+    if (kind & kind_fpe::underflow)
+    {
+        flags |= FE_UNDERFLOW;
+    }
+#endif
+#ifdef FE_INEXACT
+    if (kind & kind_fpe::inexact)
+    {
+        flags |= FE_INEXACT;
+    }
+#endif
+    return flags;
+}
+
+class context
+{
+    public:
+        // (kind_valid may include kind_fpe bits to only make those FPE
+        //  valid and the kind_fpe_ignored FPE are not tested or cleared,
+        //  e.g., to avoid clearing the inexact FPE after each division)
+        constexpr context(unsigned int const kind_valid,
+                          context_type const type,
+                          fpe_sampling const sampling = fpe_sampling::eager,
+                          unsigned int const kind_fpe_ignored =
+                              kind_fpe::none) noexcept :
+            m_kind_invalid(kind_invalid(kind_valid) & ~kind_fpe_ignored),
+            m_kind(kind::pure),
+            m_sampling(sampling),
+            m_tracking(tracking::full),
+            m_fpe_tested(context::fpe_all & ~fpe_flags(kind_fpe_ignored)),
+            m_arena(nullptr)
+        {
+            if (type == context_type::nonterminating)
+            {
+                m_kind |= kind::nonterminating;
+            }
+            if (! is_constant_evaluated())
+            {
+                statistic(&context_statistics::fpe_clears);
+                std::feclearexcept(m_fpe_tested);
+            }
+        }
+        constexpr context(context const & o) noexcept = delete;
+
+        // a context that is only tracked for 1 in rate contexts
+        // (a random decision for each thread, with regions of an untracked
+        //  context only being value wrappers and tracked contexts
+        //  providing the effects::telemetry counters)
+        [[nodiscard]] static context sampled(
+            unsigned int const kind_valid,
+            context_type const type,
+            std::uint32_t const rate,
+            fpe_sampling const sampling = fpe_sampling::eager) noexcept
+        {
+            if (context::sample_decision(rate))
+            {
+                telemetry.tracked.fetch_add(1, std::memory_order_relaxed);
+                return context(kind_valid, type, sampling,
+                               tracking::sampled);
+            }
+            return context(kind_valid, type, sampling, tracking::none);
+        }
+
+        // a context for a callee with the effects joined into this context
+        // (the FE_* flags are sampled by this context instead of being
+        //  cleared by the child context constructor)
+        [[nodiscard]] child_context child(
+            unsigned int const kind_valid,
+            context_type const type = context_type::terminating) noexcept;
+
+        template <typename T>
+        [[nodiscard]] constexpr region<T> operator ()(
+            T && t,
+            trace_location const & location =
+                trace_location::current()) noexcept
+        {
+            trace_at(location);
+            return region<T>(*this, std::forward<T>(t));
+        }
+
+        // construct the region value in-place
+        // (traced without a location, see make_at)
+        template <typename T, typename... Args>
+        [[nodiscard]] constexpr region<T> make(Args &&... args) noexcept
+        {
+            trace_at(trace_location());
+            return region<T>(*this, std::in_place,
+                             std::forward<Args>(args)...);
+        }
+
+        // construct a value in the context's arena
+        // (a nullptr region value if no arena exists or it is exhausted)
+        template <typename T, typename... Args>
+        [[nodiscard]] region<T *> alloc(Args &&... args) noexcept
+        {
+            trace_at(trace_location());
+            return allocated_region<T>(std::forward<Args>(args)...);
+        }
+
+#if defined(EFFECTS_TRACE)
+        // make and alloc with the caller location traced
+        // (e.g., c.make_at<T>(trace_location::current(), args...))
+        template <typename T, typename... Args>
+        [[nodiscard]] constexpr region<T> make_at(
+            trace_location const & location, Args &&... args) noexcept
+        {
+            trace_at(location);
+            return region<T>(*this, std::in_place,
+                             std::forward<Args>(args)...);
+        }
+        template <typename T, typename... Args>
+        [[nodiscard]] region<T *> alloc_at(
+            trace_location const & location, Args &&... args) noexcept
+        {
+            trace_at(location);
+            return allocated_region<T>(std::forward<Args>(args)...);
+        }
+#endif
+
+        template <typename T>
+        [[nodiscard]] region_span<T> span(T * const data,
+                                          std::size_t const size) noexcept
+        {
+            return region_span<T>(*this, data, size);
+        }
+        template <typename Container>
+        [[nodiscard]] auto span(Container & container) noexcept
+        {
+            return span(container.data(), container.size());
+        }
+
+        template <typename T, std::size_t N>
+        [[nodiscard]] region_array<T, N>
+        array(std::array<T, N> && values) noexcept
+        {
+            return region_array<T, N>(*this, std::move(values));
+        }
+        template <typename T, std::size_t N>
+        [[nodiscard]] region_array<T, N>
+        array(std::array<T, N> const & values) noexcept
+        {
+            return region_array<T, N>(*this, values);
+        }
+
+        // value computed by f() when the value is first used
+        template <typename F>
+        [[nodiscard]] lazy_region< std::decay_t<F> >
+        lazy(F && f,
+             trace_location const & location =
+                 trace_location::current()) noexcept
+        {
+            return lazy_region< std::decay_t<F> >(*this, std::forward<F>(f),
+                                                  location);
+        }
+
+        // result of fast() if fast() only causes the kind_fpe_allowed FPE,
+        // otherwise the result of safe() (with the FPE of fast() discarded)
+        template <typename Fast, typename Safe>
+        [[nodiscard]] auto dispatch(Fast fast, Safe safe,
+                                    unsigned int const kind_fpe_allowed =
+                                        kind_fpe::none,
+                                    trace_location const & location =
+                                        trace_location::current())
+        {
+            using result_type = std::common_type_t<
+                std::decay_t< std::invoke_result_t<Fast &> >,
+                std::decay_t< std::invoke_result_t<Safe &> >
+            >;
+            // FE_* flags set before the fast kernel are not discarded
+            update();
+            result_type result = fast();
+            fence(result);
+            unsigned int const kind = fpe_sample();
+            if ((kind & kind_fpe::bitmask & ~kind_fpe_allowed) == 0)
+            {
+                update(kind, false);
+            }
+            else
+            {
+                statistic(&context_statistics::dispatch_fallbacks);
+                result = safe();
+            }
+            trace_at(location);
+            return region<result_type>(*this, std::move(result));
+        }
+
+        constexpr void set_exception() noexcept
+        {
+            // An exception was thrown, an unignored signal was raised or
+            // execution will terminate with a function call
+            // (like exit or abort).  Throwing an exception can be pure
+            // because it doesn't interfere with referential transparency,
+            // though throwing an exception is tracked as an effect due to the
+            // need to catch the exception.
+            //
+            // Regarding stdlib.h:
+            // If the exit function was called, it operates like an exception
+            // was thrown.  If the atexit function
+            // (or the deprecated on_exit function) was called, it operates
+            // like catch.
+            // If the abort function was called, it operates like an exception
+            // was thrown.  If a signal handler exists for the SIGABRT signal,
+            // the signal handler would operate like catch.
+            //
+            // Regarding setjmp.h:
+            // If the setjmp function was called, it operates like catch.
+            // All longjmp function calls would be tracked as exceptions with
+            // the setjmp function preventing referential transparency
+            // (with the assumption that its saved calling environment
+            //  information is used due to a longjmp function call).
+            //
+            // Regarding ucontext.h:
+            // If the setcontext function or the swapcontext function was
+            // called, it operates like catch.  All ucontext_t data created
+            // with getcontext and modified with makecontext would be
+            // tracked as exceptions with the setcontext/swapcontext function
+            // preventing referential transparency
+            // (with the assumption that all ucontext_t data is used).
+            m_kind |= kind::exception;
+        }
+
+        constexpr void set_variation_os() noexcept
+        {
+            // Execution will vary due to the Operating System (OS) used,
+            // preventing the functionality from being mathematically pure.
+            // A filepath function that uses '/' characters on UNIX and
+            // '\\' on Windows for its return value is an example of
+            // kind::variation_os .
+            m_kind |= kind::variation_os;
+        }
+
+        constexpr void set_variation_hardware() noexcept
+        {
+            // Execution will vary due to the hardware used,
+            // preventing the functionality from being mathematically pure.
+            // Usage of a long type on both a 32-bit architecture and a
+            // 64-bit architecture can cause a function return value
+            // to have different possible return value limitations and
+            // is an example of kind::variation_hardware .
+            m_kind |= kind::variation_hardware;
+        }
+
+        constexpr void clear() noexcept
+        {
+            m_kind = kind::pure;
+            if (m_tracking == tracking::reported)
+            {
+                // the next check of the sampled context is reported again
+                m_tracking = tracking::sampled;
+            }
+            if (is_constant_evaluated())
+            {
+                return;
+            }
+            // a child context uses the arena of the parent
+            // without releasing the parent's allocations
+            if (m_arena != nullptr && &m_arena->owner() == this)
+            {
+                m_arena->release();
+            }
+            if (m_tracking == tracking::none)
+            {
+                // the FE_* flags are not tracked by the context
+                return;
+            }
+            statistic(&context_statistics::fpe_clears);
+            std::feclearexcept(m_fpe_tested);
+        }
+
+        constexpr void merge(unsigned int const kind) noexcept
+        {
+            // effects tracked elsewhere (e.g., in a different thread)
+            m_kind |= kind;
+        }
+
+        [[nodiscard]] constexpr unsigned int kind_valid() const noexcept
+        {
+            // including the kind_fpe bits that are valid
+            return (~m_kind_invalid) & kind_mask_all;
+        }
+
+#if defined(EFFECTS_STATISTICS)
+        [[nodiscard]] context_statistics statistics() const noexcept
+        {
+            // a snapshot of the counters (not reset by clear)
+            return m_statistics;
+        }
+#endif
+
+#if defined(EFFECTS_TRACE)
+        [[nodiscard]] trace_log const & trace() const noexcept
+        {
+            // the kind bits in the order they were added
+            // (with the log preserved when the context is cleared)
+            return m_trace;
+        }
+#endif
+
+        [[nodiscard]] constexpr bool valid() noexcept
+        {
+            update();
+            bool const result = (m_kind_invalid & m_kind) == 0;
+            if (m_tracking == tracking::sampled)
+            {
+                report(result);
+            }
+            return result;
+        }
+
+        [[nodiscard]] constexpr bool tracked() const noexcept
+        {
+            // false for an untracked context::sampled context
+            return m_tracking != tracking::none;
+        }
+
+        constexpr void sample() noexcept
+        {
+            // a checkpoint for reading the FE_* flags
+            // (necessary with fpe_sampling::deferred if floating-point
+            //  values will be modified before the context is checked)
+            update();
+        }
+
+        [[nodiscard]] constexpr unsigned int kind() noexcept
+        {
+            if (m_sampling == fpe_sampling::deferred)
+            {
+                update();
+            }
+            return m_kind;
+        }
+        [[nodiscard]] constexpr unsigned int kind() const noexcept
+        {
+            // up to date with fpe_sampling::eager, and the FE_* flags
+            // since the last sample with fpe_sampling::deferred
+            return m_kind;
+        }
+
+        [[nodiscard]] constexpr bool is_pure() noexcept
+        {
+            update();
+            return m_kind == kind::pure;
+        }
+        [[nodiscard]] constexpr bool has_nonterminating() noexcept
+        {
+            update();
+            return m_kind & kind::nonterminating;
+        }
+        [[nodiscard]] constexpr bool has_exception() noexcept
+        {
+            update();
+            return m_kind & kind::exception;
+        }
+        [[nodiscard]] constexpr bool has_reference() noexcept
+        {
+            update();
+            return m_kind & kind::reference;
+        }
+        [[nodiscard]] constexpr bool has_write() noexcept
+        {
+            update();
+            return m_kind & kind::write;
+        }
+        [[nodiscard]] constexpr bool has_fpe() noexcept
+        {
+            update();
+            return m_kind & kind::fpe;
+        }
+        [[nodiscard]] constexpr bool has_fpe(unsigned int & kind) noexcept
+        {
+            bool const result = has_fpe();
+            kind = m_kind;
+            return result;
+        }
+        [[nodiscard]] constexpr bool has_variation_os() noexcept
+        {
+            update();
+            return m_kind & kind::variation_os;
+        }
+        [[nodiscard]] constexpr bool has_variation_hardware() noexcept
+        {
+            update();
+            return m_kind & kind::variation_hardware;
+        }
+
+    protected:
+        constexpr context(context const & parent,
+                          unsigned int const kind_valid,
+                          context_type const type) noexcept :
+            m_kind_invalid(kind_invalid(kind_valid) &
+                           ~kind_fpe_of(context::fpe_all &
+                                        ~parent.m_fpe_tested)),
+            m_kind(type == context_type::nonterminating ?
+                   kind::nonterminating : kind::pure),
+            m_sampling(parent.m_sampling),
+            m_tracking(parent.m_tracking == tracking::none ?
+                       tracking::none : tracking::full),
+            m_fpe_tested(parent.m_fpe_tested),
+            m_arena(parent.m_arena)
+        {
+            // the FE_* flags are not cleared (see child)
+        }
+
+    private:
+        template <typename, typename> friend class region;
+        template <typename> friend class region_span;
+        template <typename, std::size_t> friend class region_array;
+        template <typename> friend class lazy_region;
+        template <typename, typename> friend class region_vector;
+        template <typename, typename, typename, typename>
+        friend class region_map;
+        template <unsigned int, context_type> friend class static_context;
+        friend class current_context;
+        friend class arena;
+
+        enum struct tracking : unsigned char
+        {
+            full,
+            sampled,    // tracked by context::sampled
+            reported,   // sampled with telemetry provided
+            none        // not tracked by context::sampled
+        };
+
+        context(unsigned int const kind_valid,
+                context_type const type,
+                fpe_sampling const sampling,
+                tracking const tracked) noexcept :
+            m_kind_invalid(kind_invalid(kind_valid)),
+            m_kind(type == context_type::nonterminating ?
+                   kind::nonterminating : kind::pure),
+            m_sampling(sampling),
+            m_tracking(tracked),
+            m_fpe_tested(context::fpe_all),
+            m_arena(nullptr)
+        {
+            if (m_tracking != tracking::none)
+            {
+                statistic(&context_statistics::fpe_clears);
+                std::feclearexcept(context::fpe_all);
+            }
+        }
+
+        [[nodiscard]] static bool sample_decision(
+            std::uint32_t const rate) noexcept
+        {
+            // xorshift64 with a separate state for each thread
+            static thread_local std::uint64_t state = 0;
+            if (state == 0)
+            {
+                state = (static_cast<std::uint64_t>(
+                    reinterpret_cast<std::uintptr_t>(&state)) *
+                    0x9e3779b97f4a7c15ULL) | 1;
+            }
+            state ^= state << 13;
+            state ^= state >> 7;
+            state ^= state << 17;
+            return rate <= 1 || state % rate == 0;
+        }
+
+        void report(bool const result) noexcept
+        {
+            m_tracking = tracking::reported;
+            telemetry.checked.fetch_add(1, std::memory_order_relaxed);
+            if (result)
+            {
+                return;
+            }
+            telemetry.invalid.fetch_add(1, std::memory_order_relaxed);
+            unsigned int kind_invalid = m_kind & m_kind_invalid;
+            if (kind_invalid & kind::fpe)
+            {
+                kind_invalid |= m_kind & kind_fpe::bitmask;
+            }
+            for (std::size_t i = 0; i < telemetry.invalid_kind.size(); ++i)
+            {
+                if (kind_invalid & (1U << i))
+                {
+                    telemetry.invalid_kind[i].fetch_add(
+                        1, std::memory_order_relaxed);
+                }
+            }
+        }
+
+        template <typename T>
+        constexpr void created_value(T const & value)
+        {
+            statistic(&context_statistics::values);
+            track_value(value);
+        }
+
+        template <typename T>
+        constexpr void created_constant(T const & constant)
+        {
+            statistic(&context_statistics::constants);
+            track_constant(constant);
+        }
+
+        template <typename T>
+        constexpr void created_reference(T const & reference)
+        {
+            statistic(&context_statistics::references);
+            track_reference(reference);
+        }
+
+        template <typename T>
+        constexpr void created_values(T const * const values,
+                                      std::size_t const size)
+        {
+            statistic(&context_statistics::values);
+            track_values(values, size);
+        }
+
+        template <typename T>
+        constexpr void created_references(T const * const references,
+                                          std::size_t const size)
+        {
+            statistic(&context_statistics::references);
+            track_references(references, size);
+        }
+
+        template <typename T>
+        constexpr void assigned_value(T const & value)
+        {
+            statistic(&context_statistics::assignments);
+            track_value(value);
+        }
+
+        template <typename T>
+        constexpr void assigned_reference(T const & reference)
+        {
+            statistic(&context_statistics::assignments);
+            track_reference(reference);
+        }
+
+        template <typename T>
+        constexpr void assigned_values(T const * const values,
+                                       std::size_t const size)
+        {
+            statistic(&context_statistics::assignments);
+            track_values(values, size);
+        }
+
+        template <typename T>
+        constexpr void assigned_references(T const * const references,
+                                           std::size_t const size)
+        {
+            statistic(&context_statistics::assignments);
+            track_references(references, size);
+        }
+
+        template <typename T>
+        constexpr void track_value(T const & value)
+        {
+            if (m_tracking == tracking::none)
+            {
+                return;
+            }
+            unsigned int kind = variation<T>();
+            if (is_memory_written(value))
+            {
+                kind |= kind::write;
+            }
+            if (is_floating_point<T>::value)
+            {
+                // floating-point use is a reference effect due to fesetround
+                // (this code assumes a round occurred because a round
+                //  often occurs when floating-point is used)
+                kind |= kind::reference;
+            }
+            fence(value);
+            update(kind, is_floating_point<T>::value);
+        }
+
+        // variation effects of the type and of floating-point use
+        template <typename T>
+        [[nodiscard]] static constexpr unsigned int variation() noexcept
+        {
+            unsigned int kind =
+                kind_variation< std::remove_cv_t<T> >::value;
+            if constexpr (is_floating_point<T>::value)
+            {
+                if (! is_constant_evaluated())
+                {
+                    kind |= floating_point_variation.load(
+                        std::memory_order_relaxed);
+                }
+            }
+            return kind;
+        }
+
+        // container storage allocated by an operation is a write effect
+        // (unless the storage is in the context's arena)
+        template <typename T>
+        constexpr void allocated(T const * const storage)
+        {
+            if (m_tracking == tracking::none)
+            {
+                return;
+            }
+            statistic(&context_statistics::allocations);
+            update(is_memory_written(storage) ? kind::write : kind::pure,
+                   false);
+        }
+
+        // the floating-point value is computed before the FPE are tested
+        // (instead of the optimizer moving the computation after the test)
+        template <typename T>
+        static constexpr void fence(T const & value) noexcept
+        {
+            if constexpr (is_floating_point<T>::value)
+            {
+                if (! is_constant_evaluated())
+                {
+                    barrier(value);
+                }
+            }
+        }
+
+        template <typename T>
+        constexpr void track_constant(T const & constant)
+        {
+            if (m_tracking == tracking::none)
+            {
+                return;
+            }
+            unsigned int kind = variation<T>();
+            if (is_memory_written(constant))
+            {
+                kind |= kind::write;
+            }
+            update(kind, is_floating_point<T>::value);
+        }
+
+        template <typename T>
+        constexpr void track_reference(T const & reference)
+        {
+            if (m_tracking == tracking::none)
+            {
+                return;
+            }
+            unsigned int kind = kind::reference | variation<T>();
+            if (is_memory_written(reference))
+            {
+                kind |= kind::write;
+            }
+            update(kind, is_floating_point<T>::value);
+        }
+
+        template <typename T>
+        constexpr void track_values(T const * const values,
+                                    std::size_t const size)
+        {
+            if (m_tracking == tracking::none)
+            {
+                return;
+            }
+            unsigned int kind = variation<T>();
+            if (is_memory_written(values, size))
+            {
+                kind |= kind::write;
+            }
+            if (is_floating_point<T>::value)
+            {
+                // (see track_value)
+                kind |= kind::reference;
+            }
+            fence(values);
+            update(kind, is_floating_point<T>::value);
+        }
+
+        template <typename T>
+        constexpr void track_references(T const * const references,
+                                        std::size_t const size)
+        {
+            if (m_tracking == tracking::none)
+            {
+                return;
+            }
+            unsigned int kind = kind::reference | variation<T>();
+            if (is_memory_written(references, size))
+            {
+                kind |= kind::write;
+            }
+            update(kind, is_floating_point<T>::value);
+        }
+
+        template <typename T>
+        [[nodiscard]] constexpr bool is_memory_written(
+            T const * const values, std::size_t const size) const noexcept
+        {
+            if constexpr (std::is_pointer<T>::value)
+            {
+                for (std::size_t i = 0; i < size; ++i)
+                {
+                    if (is_memory_written(values[i]))
+                    {
+                        return true;
+                    }
+                }
+            }
+            return false;
+        }
+
+        template <typename T>
+        [[nodiscard]] constexpr bool is_memory_written(T const & value)
+            const noexcept
+        {
+            // owned memory in the context's arena is not global data
+            if constexpr (std::is_pointer<T>::value)
+            {
+                return context::is_memory_owned(value) &&
+                       (m_arena == nullptr || ! m_arena->contains(value));
+            }
+            else
+            {
+                return false;
+            }
+        }
+
+        template <typename T>
+        [[nodiscard]] static constexpr bool is_memory_owned(T const & value)
+        {
+            // if the value is a non-null pointer, assume it is owned memory
+            // on the heap which implies a write effect, unless
+            // a memory_classifier is provided
+            // (a reference effect is usage of memory not owned)
+            if constexpr (std::is_pointer<T>::value)
+            {
+                if (value == static_cast<T>(0))
+                {
+                    return false;
+                }
+                if (is_constant_evaluated())
+                {
+                    return true;
+                }
+                memory_classifier_t const classifier =
+                    memory_classifier.load(std::memory_order_relaxed);
+                return classifier == nullptr ||
+                       classifier(reinterpret_cast<void const *>(
+                           reinterpret_cast<std::uintptr_t>(value)));
+            }
+            else
+            {
+                return false;
+            }
+        }
+
+        constexpr void update(unsigned int kind,
+                              bool const floating_point) noexcept
+        {
+            if (m_tracking == tracking::none)
+            {
+                return;
+            }
+            if (floating_point && m_sampling == fpe_sampling::eager &&
+                ! is_constant_evaluated())
+            {
+                kind |= fpe_sample();
+            }
+            trace_added(kind);
+            m_kind |= kind;
+        }
+
+        constexpr void update() noexcept
+        {
+            if (m_tracking == tracking::none)
+            {
+                return;
+            }
+            if (is_constant_evaluated())
+            {
+                // no floating-point environment during constant evaluation
+                return;
+            }
+            unsigned int const kind = fpe_sample();
+            trace_added(kind);
+            m_kind |= kind;
+        }
+
+        unsigned int fpe_sample() noexcept
+        {
+            unsigned int const kind = context::fpe_capture(m_fpe_tested);
+            statistic(&context_statistics::fpe_reads);
+            if (kind != kind::pure)
+            {
+                // fpe_capture cleared the FE_* flags
+                statistic(&context_statistics::fpe_reads_set);
+                statistic(&context_statistics::fpe_clears);
+            }
+            return kind;
+        }
+
+        constexpr void statistic(
+            std::uint64_t context_statistics::* const counter) noexcept
+        {
+#if defined(EFFECTS_STATISTICS)
+            ++(m_statistics.*counter);
+#else
+            static_cast<void>(counter);
+#endif
+        }
+
+        template <typename T, typename... Args>
+        [[nodiscard]] region<T *> allocated_region(Args &&... args) noexcept
+        {
+            static_assert(std::is_trivially_destructible<T>::value,
+                          "Arena memory is released without destructors");
+            void * const p = m_arena == nullptr ? nullptr :
+                m_arena->try_allocate(sizeof(T), alignof(T));
+            T * value = p == nullptr ? nullptr :
+                new (p) T(std::forward<Args>(args)...);
+            return region<T *>(*this, std::move(value));
+        }
+
+        constexpr void trace_at(trace_location const & location) noexcept
+        {
+#if defined(EFFECTS_TRACE)
+            m_location = location;
+#else
+            static_cast<void>(location);
+#endif
+        }
+
+        constexpr void trace_added(unsigned int const kind) noexcept
+        {
+#if defined(EFFECTS_TRACE)
+            unsigned int added = kind & ~m_kind;
+            if (added == 0 || is_constant_evaluated())
+            {
+                return;
+            }
+            std::uint64_t const timestamp = context::trace_timestamp();
+            do
+            {
+                unsigned int const bit = added & (~added + 1);
+                m_trace.append(bit, m_location, timestamp);
+                added &= ~bit;
+            } while (added);
+#else
+            static_cast<void>(kind);
+#endif
+        }
+
+        static constexpr unsigned int fpe_all =
+#ifdef FE_INVALID
+            FE_INVALID |
+#endif
+#ifdef FE_DIVBYZERO
+            FE_DIVBYZERO |
+#endif
+#ifdef FE_OVERFLOW
+            FE_OVERFLOW |
+#endif
+#ifdef FE_UNDERFLOW
+            FE_UNDERFLOW |
+#endif
+#ifdef FE_INEXACT
+            FE_INEXACT |
+#endif
+            0;
+
+        [[nodiscard]] static constexpr unsigned int kind_fpe_of(
+            int const flags) noexcept
+        {
+            return context::fpe_kind(flags) & kind_fpe::bitmask;
+        }
+
+        [[nodiscard]] static constexpr unsigned int fpe_kind(
+            int const flags) noexcept
+        {
+            unsigned int kind = kind_fpe::none;
+#ifdef FE_INVALID
+            if (flags & FE_INVALID)
+            {
+                kind |= kind_fpe::invalid;
+            }
+#endif
+#ifdef FE_DIVBYZERO
+            if (flags & FE_DIVBYZERO)
+            {
+                kind |= kind_fpe::divide_by_zero;
+            }
+#endif
+#ifdef FE_OVERFLOW
+            if (flags & FE_OVERFLOW)
+            {
+                kind |= kind_fpe::overflow;
+            }
+#endif
+#ifdef FE_UNDERFLOW
+            if (flags & FE_UNDERFLOW)
+            {
+                kind |= kind_fpe::underflow;
+            }
+#endif
+#ifdef FE_INEXACT
+            if (flags & FE_INEXACT)
+            {
+                kind |= kind_fpe::inexact;
+            }
+#endif
+            if (kind != kind_fpe::none)
+            {
+                kind |= kind::fpe;
+            }
+            return kind;
+        }
+
+        // kind_fpe values indexed by the FE_* flags set
+        // (only used when the FE_* flags are small bit values, e.g., x86)
+        struct fpe_table
+        {
+            static constexpr bool used = context::fpe_all <= 0xff;
+            static constexpr unsigned int size =
+                used ? context::fpe_all + 1 : 1;
+
+            constexpr fpe_table() :
+                kind()
+            {
+                for (unsigned int flags = 0; flags < size; ++flags)
+                {
+                    kind[flags] = context::fpe_kind(flags);
+                }
+            }
+
+            unsigned int kind[size];
+        };
+
+#if defined(EFFECTS_TRACE)
+        [[nodiscard]] static std::uint64_t trace_timestamp() noexcept
+        {
+#if defined(__x86_64__) || defined(__i386__)
+            return __rdtsc();
+#else
+            return std::chrono::steady_clock::now().time_since_epoch().count();
+#endif
+        }
+#endif
+
+        [[nodiscard]] static unsigned int fpe_capture(
+            int const tested = context::fpe_all) noexcept
+        {
+            // read the FE_* flags once and only clear the flags when
+            // some are set (to avoid modifying the floating-point
+            // status register when no floating-point exceptions occurred)
+            int const flags = std::fetestexcept(tested);
+            if (flags == 0)
+            {
+                return kind::pure;
+            }
+            std::feclearexcept(flags);
+            if constexpr (fpe_table::used)
+            {
+                static constexpr fpe_table lookup;
+                return lookup.kind[flags];
+            }
+            else
+            {
+                return context::fpe_kind(flags);
+            }
+        }
+
+        unsigned int const m_kind_invalid;
+        unsigned int m_kind;
+        fpe_sampling const m_sampling;
+        tracking m_tracking;
+        int const m_fpe_tested;
+        arena * m_arena;
+#if defined(EFFECTS_TRACE)
+        trace_location m_location;
+        trace_log m_trace;
+#endif
+#if defined(EFFECTS_STATISTICS)
+        context_statistics m_statistics;
+#endif
+};
+
+inline arena::arena(context & c,
+                    void * const buffer,
+                    std::size_t const size) noexcept :
+    m_context(c),
+    m_previous(c.m_arena),
+    m_buffer(static_cast<unsigned char *>(buffer)),
+    m_size(size),
+    m_used(0)
+{
+    m_context.m_arena = this;
+}
+
+inline arena::~arena() noexcept
+{
+    m_context.m_arena = m_previous;
+}
+
+// context created by context::child
+// (the effects are joined into the parent context when the child context
+//  is destroyed or when join is called)
+class child_context : public context
+{
+    public:
+        child_context(child_context const & o) noexcept = delete;
+        ~child_context() noexcept
+        {
+            join();
+        }
+
+        void join() noexcept
+        {
+            // bitwise-OR the effects into the parent context
+            // (which may occur multiple times)
+            m_parent.merge(kind());
+        }
+
+    private:
+        friend class context;
+
+        child_context(context & parent,
+                      unsigned int const kind_valid,
+                      context_type const type) noexcept :
+            context(parent, kind_valid, type),
+            m_parent(parent)
+        {
+        }
+
+        context & m_parent;
+};
+
+inline child_context context::child(unsigned int const kind_valid,
+                                    context_type const type) noexcept
+{
+    // any FE_* flags set are attributed to this context before the
+    // child context is used (a single read of the FE_* flags)
+    update();
+    return child_context(*this, kind_valid, type);
+}
+
+#if ! defined(EFFECTS_SITE_STABLE)
+#define EFFECTS_SITE_STABLE 64
+#endif
+
+// effects observed at a call site (shared by all threads)
+// (the call site is stable after EFFECTS_SITE_STABLE calls without
+//  new effects, so only the value-dependent effects are checked)
+class site_summary
+{
+    public:
+        static constexpr std::uint32_t stable_calls = EFFECTS_SITE_STABLE;
+
+        constexpr site_summary() noexcept :
+            m_kind(kind::pure),
+            m_calls(0),
+            m_calls_unchanged(0)
+        {
+        }
+        site_summary(site_summary const & o) noexcept = delete;
+
+        [[nodiscard]] unsigned int kind() const noexcept
+        {
+            // the union of the effects observed
+            return m_kind.load(std::memory_order_relaxed);
+        }
+
+        [[nodiscard]] std::uint64_t calls() const noexcept
+        {
+            return m_calls.load(std::memory_order_relaxed);
+        }
+
+        [[nodiscard]] bool stable() const noexcept
+        {
+            return m_calls_unchanged.load(std::memory_order_relaxed) >=
+                   stable_calls;
+        }
+
+        void record(unsigned int const kind) noexcept
+        {
+            m_calls.fetch_add(1, std::memory_order_relaxed);
+            unsigned int const kind_previous =
+                m_kind.load(std::memory_order_relaxed);
+            if ((kind_previous | kind) != kind_previous)
+            {
+                m_kind.fetch_or(kind, std::memory_order_relaxed);
+                m_calls_unchanged.store(0, std::memory_order_relaxed);
+            }
+            else if (! stable())
+            {
+                m_calls_unchanged.fetch_add(1, std::memory_order_relaxed);
+            }
+        }
+
+    private:
+        std::atomic<unsigned int> m_kind;
+        std::atomic<std::uint64_t> m_calls;
+        std::atomic<std::uint32_t> m_calls_unchanged;
+};
+
+// context for a call site with the effects recorded in a site_summary
+// (a stable call site uses fpe_sampling::deferred, so the FE_* flags
+//  are read once instead of for each floating-point region)
+class site_context : public context
+{
+    public:
+        site_context(site_summary & summary,
+                     unsigned int const kind_valid,
+                     context_type const type =
+                         context_type::terminating) noexcept :
+            context(kind_valid, type,
+                    summary.stable() ? fpe_sampling::deferred :
+                                       fpe_sampling::eager),
+            m_summary(summary)
+        {
+        }
+        site_context(site_context const & o) noexcept = delete;
+        ~site_context() noexcept
+        {
+            m_summary.record(kind());
+        }
+
+    private:
+        site_summary & m_summary;
+};
+
+// a site_context c with a function-local static site_summary
+#define EFFECTS_FUNCTION(c, kind_valid) \
+    static ::effects::site_summary c##_site_summary; \
+    ::effects::site_context c(c##_site_summary, (kind_valid))
+
+// context with the type-derived effects checked at compile time
+// (only Floating-Point Exceptions (FPE), non-null pointers and the
+//  set_* functions, which depend on execution, are tracked at runtime,
+//  and only when they are not included in KindValid)
+template <unsigned int KindValid,
+          context_type Type = context_type::terminating>
+class static_context
+{
+    private:
+        static_assert((KindValid & ~kind::bitmask) == 0,
+                      "KindValid contains invalid kind values");
+        static_assert(Type == context_type::terminating ||
+                      (KindValid & kind::nonterminating),
+                      "Invalid kind::nonterminating effect");
+
+    public:
+        static constexpr unsigned int kind_valid = KindValid;
+
+        constexpr static_context() noexcept :
+            m_kind(kind::pure)
+        {
+            if constexpr (static_context::fpe_tracked)
+            {
+                std::feclearexcept(context::fpe_all);
+            }
+        }
+        constexpr static_context(static_context const & o) noexcept = delete;
+
+        template <typename T>
+        [[nodiscard]] constexpr region<T, static_context>
+        operator ()(T && t) noexcept
+        {
+            return region<T, static_context>(*this, std::forward<T>(t));
+        }
+
+        // construct the region value in-place
+        template <typename T, typename... Args>
+        [[nodiscard]] constexpr region<T, static_context>
+        make(Args &&... args) noexcept
+        {
+            return region<T, static_context>(*this, std::in_place,
+                                             std::forward<Args>(args)...);
+        }
+
+        constexpr void set_exception() noexcept
+        {
+            // (see context::set_exception)
+            m_kind |= kind::exception;
+        }
+
+        constexpr void set_variation_os() noexcept
+        {
+            // (see context::set_variation_os)
+            m_kind |= kind::variation_os;
+        }
+
+        constexpr void set_variation_hardware() noexcept
+        {
+            // (see context::set_variation_hardware)
+            m_kind |= kind::variation_hardware;
+        }
+
+        void clear() noexcept
+        {
+            m_kind = kind::pure;
+            if constexpr (static_context::fpe_tracked)
+            {
+                std::feclearexcept(context::fpe_all);
+            }
+        }
+
+        [[nodiscard]] bool valid() noexcept
         {
             update();
-            return m_kind == kind::pure;
+            return (m_kind & ~KindValid) == 0;
+        }
+
+        [[nodiscard]] unsigned int kind() const noexcept
+        {
+            // only the effects tracked at runtime
+            return m_kind;
+        }
+
+    private:
+        template <typename, typename> friend class region;
+
+        static constexpr bool fpe_tracked = ! (KindValid & kind::fpe);
+        static constexpr bool write_tracked = ! (KindValid & kind::write);
+        static constexpr bool variation_tracked =
+            (~KindValid &
+             (kind::variation_os | kind::variation_hardware)) != 0;
+
+        template <typename T>
+        constexpr void created_value(T const & value) noexcept
+        {
+            static_assert(! is_floating_point<T>::value ||
+                          (KindValid & kind::reference),
+                          "Invalid kind::reference effect "
+                          "(floating-point rounding)");
+            created<T>(value);
+        }
+
+        template <typename T>
+        constexpr void assigned_value(T const & value) noexcept
+        {
+            created_value(value);
+        }
+
+        template <typename T>
+        constexpr void created_constant(T const & constant) noexcept
+        {
+            created<T>(constant);
+        }
+
+        template <typename T>
+        constexpr void created_reference(T const & reference) noexcept
+        {
+            static_assert(KindValid & kind::reference,
+                          "Invalid kind::reference effect");
+            created<T>(reference);
+        }
+
+        template <typename T>
+        constexpr void assigned_reference(T const & reference) noexcept
+        {
+            created_reference(reference);
+        }
+
+        template <typename T>
+        constexpr void created(T const & value) noexcept
+        {
+            static_assert((kind_variation< std::remove_cv_t<T> >::value &
+                           ~KindValid) == 0,
+                          "Invalid kind::variation_* effect (type)");
+            if constexpr (static_context::variation_tracked &&
+                          is_floating_point<T>::value)
+            {
+                if (! is_constant_evaluated())
+                {
+                    m_kind |= floating_point_variation.load(
+                                  std::memory_order_relaxed) & ~KindValid;
+                }
+            }
+            if constexpr (static_context::write_tracked &&
+                          std::is_pointer<T>::value)
+            {
+                if (context::is_memory_owned(value))
+                {
+                    m_kind |= kind::write;
+                }
+            }
+            if constexpr (static_context::fpe_tracked &&
+                          is_floating_point<T>::value)
+            {
+                barrier(value);
+                m_kind |= context::fpe_capture();
+            }
+        }
+
+        void update() noexcept
+        {
+            if constexpr (static_context::fpe_tracked)
+            {
+                m_kind |= context::fpe_capture();
+            }
+        }
+
+        unsigned int m_kind;
+};
+
+// the current context of the thread, used by region<T, current_context>
+// (a thread-local stack of contexts, with the most recent
+//  current_context object providing the current context)
+class current_context
+{
+    public:
+        explicit current_context(context & c) noexcept :
+            m_previous(current_context::m_current)
+        {
+            current_context::m_current = &c;
+        }
+        current_context(current_context const & o) noexcept = delete;
+        ~current_context() noexcept
+        {
+            current_context::m_current = m_previous;
+        }
+
+        template <typename T>
+        [[nodiscard]] region<T, current_context> operator ()(
+            T && t,
+            trace_location const & location =
+                trace_location::current()) noexcept
+        {
+            current_context::reference().trace_at(location);
+            return region<T, current_context>(std::forward<T>(t));
+        }
+
+        // construct the region value in-place
+        // (see context::make and context::make_at)
+        template <typename T, typename... Args>
+        [[nodiscard]] region<T, current_context>
+        make(Args &&... args) noexcept
+        {
+            current_context::reference().trace_at(trace_location());
+            return region<T, current_context>(std::in_place,
+                                              std::forward<Args>(args)...);
+        }
+#if defined(EFFECTS_TRACE)
+        template <typename T, typename... Args>
+        [[nodiscard]] region<T, current_context> make_at(
+            trace_location const & location, Args &&... args) noexcept
+        {
+            current_context::reference().trace_at(location);
+            return region<T, current_context>(std::in_place,
+                                              std::forward<Args>(args)...);
+        }
+#endif
+
+        [[nodiscard]] static context * get() noexcept
+        {
+            // nullptr if no current_context object exists in this thread
+            return current_context::m_current;
+        }
+
+    private:
+        template <typename, typename> friend class region;
+
+        [[nodiscard]] static context & reference() noexcept
+        {
+            return *current_context::m_current;
+        }
+
+        context * const m_previous;
+        static inline thread_local context * m_current = nullptr;
+};
+
+// cache line size used for padding to avoid false sharing
+inline constexpr std::size_t cache_line_size = 64;
+
+// context shared by multiple threads
+// (each thread uses a shared_context::shard, a context with the kind bits
+//  and FE_* flags of the thread, that is merged into the shared_context
+//  with an atomic bitwise-OR when the shard is joined)
+class shared_context
+{
+    public:
+        class shard;
+
+        shared_context(unsigned int const kind_valid,
+                       context_type const type) noexcept :
+            m_kind(type == context_type::nonterminating ?
+                   kind::nonterminating : kind::pure),
+            m_kind_invalid(kind_invalid(kind_valid))
+        {
         }
-        [[nodiscard]] bool has_nonterminating() noexcept
+        shared_context(shared_context const & o) noexcept = delete;
+
+        void set_exception() noexcept
         {
-            update();
-            return m_kind & kind::nonterminating;
+            // (see context::set_exception)
+            merge(kind::exception);
         }
-        [[nodiscard]] bool has_exception() noexcept
+
+        void set_variation_os() noexcept
         {
-            update();
-            return m_kind & kind::exception;
+            // (see context::set_variation_os)
+            merge(kind::variation_os);
         }
-        [[nodiscard]] bool has_reference() noexcept
+
+        void set_variation_hardware() noexcept
         {
-            update();
-            return m_kind & kind::reference;
+            // (see context::set_variation_hardware)
+            merge(kind::variation_hardware);
         }
-        [[nodiscard]] bool has_write() noexcept
+
+        void clear() noexcept
         {
-            update();
-            return m_kind & kind::write;
+            // only when no shards exist
+            m_kind.store(kind::pure, std::memory_order_relaxed);
         }
-        [[nodiscard]] bool has_fpe() noexcept
+
+        [[nodiscard]] bool valid() const noexcept
         {
-            update();
-            return m_kind & kind::fpe;
+            return (m_kind_invalid & kind()) == 0;
         }
-        [[nodiscard]] bool has_fpe(unsigned int & kind) noexcept
+
+        [[nodiscard]] unsigned int kind() const noexcept
         {
-            bool const result = has_fpe();
-            kind = m_kind;
-            return result;
+            // the effects of all joined shards
+            return m_kind.load(std::memory_order_acquire);
         }
-        [[nodiscard]] bool has_variation_os() noexcept
+
+        [[nodiscard]] bool is_pure() const noexcept
         {
-            update();
-            return m_kind & kind::variation_os;
+            return kind() == kind::pure;
         }
-        [[nodiscard]] bool has_variation_hardware() noexcept
+        [[nodiscard]] bool has_fpe() const noexcept
         {
-            update();
-            return m_kind & kind::variation_hardware;
+            return kind() & kind::fpe;
         }
 
     private:
-        template <typename> friend class region;
-
-        template <typename T>
-        void created_value(T const & value)
+        void merge(unsigned int const kind) noexcept
         {
-            unsigned int kind = kind::pure;
-            if (context::is_memory_owned(value))
-            {
-                kind |= kind::write;
-            }
-            if (is_floating_point<T>::value)
-            {
-                // floating-point use is a reference effect due to fesetround
-                // (this code assumes a round occurred because a round
-                //  often occurs when floating-point is used)
-                kind |= kind::reference;
-            }
-            update(kind, is_floating_point<T>::value);
+            m_kind.fetch_or(kind, std::memory_order_release);
         }
 
-        template <typename T>
-        void created_constant(T const & constant)
+        [[nodiscard]] unsigned int kind_valid() const noexcept
         {
-            unsigned int kind = kind::pure;
-            if (context::is_memory_owned(constant))
-            {
-                kind |= kind::write;
-            }
-            update(kind, is_floating_point<T>::value);
+            return (~m_kind_invalid) & kind_mask_all;
         }
 
-        template <typename T>
-        void created_reference(T const & reference)
-        {
-            unsigned int kind = kind::reference;
-            if (context::is_memory_owned(reference))
-            {
-                kind |= kind::write;
-            }
-            update(kind, is_floating_point<T>::value);
-        }
+        alignas(cache_line_size) std::atomic<unsigned int> m_kind;
+        unsigned int const m_kind_invalid;
+};
 
-        template <typename T>
-        [[nodiscard]] static constexpr bool is_memory_owned(T const & value)
+// context used by a single thread for a shared_context
+// (aligned to a cache line to avoid false sharing between shards)
+class alignas(cache_line_size) shared_context::shard : public context
+{
+    public:
+        explicit shard(shared_context & parent,
+                       fpe_sampling const sampling =
+                           fpe_sampling::eager) noexcept :
+            context(parent.kind_valid(), context_type::terminating, sampling),
+            m_parent(parent)
         {
-            // if the value is a non-null pointer, assume it is owned memory
-            // on the heap which implies a write effect
-            // (a reference effect is usage of memory not owned)
-            return std::is_pointer<T>::value && value != static_cast<T>(0);
         }
-
-        void update(unsigned int kind, bool const floating_point) noexcept
+        shard(shard const & o) noexcept = delete;
+        ~shard() noexcept
         {
-            if (floating_point && std::fetestexcept(context::fpe_all))
-            {
-#ifdef FE_INVALID
-                if (std::fetestexcept(FE_INVALID))
-                {
-                    kind |= kind::fpe | kind_fpe::invalid;
-                }
-#endif
-#ifdef FE_DIVBYZERO
-                if (std::fetestexcept(FE_DIVBYZERO))
-                {
-                    kind |= kind::fpe | kind_fpe::divide_by_zero;
-                }
-#endif
-#ifdef FE_OVERFLOW
-                if (std::fetestexcept(FE_OVERFLOW))
-                {
-                    kind |= kind::fpe | kind_fpe::overflow;
-                }
-#endif
-#ifdef FE_UNDERFLOW
-                if (std::fetestexcept(FE_UNDERFLOW))
-                {
-                    kind |= kind::fpe | kind_fpe::underflow;
-                }
-#endif
-#ifdef FE_INEXACT
-                if (std::fetestexcept(FE_INEXACT))
-                {
-                    kind |= kind::fpe | kind_fpe::inexact;
-                }
-#endif
-                std::feclearexcept(context::fpe_all);
-            }
-            m_kind |= kind;
+            join();
         }
 
-        void update() noexcept
+        void join() noexcept
         {
-            update(kind::pure, true);
+            // sample the FE_* flags of this thread and merge the effects
+            // into the shared_context (which may occur multiple times)
+            sample();
+            m_parent.merge(kind());
         }
 
-        static constexpr unsigned int fpe_all =
-#ifdef FE_INVALID
-            FE_INVALID |
-#endif
-#ifdef FE_DIVBYZERO
-            FE_DIVBYZERO |
-#endif
-#ifdef FE_OVERFLOW
-            FE_OVERFLOW |
-#endif
-#ifdef FE_UNDERFLOW
-            FE_UNDERFLOW |
-#endif
-#ifdef FE_INEXACT
-            FE_INEXACT |
-#endif
-            0;
-
-        unsigned int const m_kind_invalid;
-        unsigned int m_kind;
+    private:
+        shared_context & m_parent;
 };
 
-template <typename T>
-constexpr region<T>::region(context & c, T && value) noexcept :
+// result of f() with an exception thrown by f() recorded as a
+// kind::exception effect before the exception is rethrown
+// (the non-throwing path has no cost with zero-cost exception handling
+//  and no exception handling is used if f() is noexcept)
+template <typename Context, typename F>
+decltype(auto) guarded(Context & c, F && f)
+{
+    if constexpr (std::is_nothrow_invocable_v<F &>)
+    {
+        return f();
+    }
+    else
+    {
+        try
+        {
+            return f();
+        }
+        catch (...)
+        {
+            c.set_exception();
+            throw;
+        }
+    }
+}
+
+template <typename T, typename Context>
+constexpr region<T, Context>::region(Context & c, T && value) noexcept :
     m_context(c),
     m_value(std::move(value))
 {
     m_context.created_value(m_value);
 }
 
-template <typename T>
-constexpr region<T>::region(context & c, T const & value) noexcept :
+template <typename T, typename Context>
+constexpr region<T, Context>::region(Context & c, T const & value) noexcept :
     m_context(c),
     m_value(value)
 {
     m_context.created_value(m_value);
 }
 
-template <typename T>
-constexpr region<T> & region<T>::operator = (T && rhs) noexcept
+template <typename T, typename Context>
+template <typename... Args>
+constexpr region<T, Context>::region(Context & c, std::in_place_t,
+                                     Args &&... args) noexcept :
+    m_context(c),
+    m_value(std::forward<Args>(args)...)
 {
-    m_value = rhs;
     m_context.created_value(m_value);
+}
+
+template <typename T, typename Context>
+constexpr region<T, Context> &
+region<T, Context>::operator = (T && rhs) noexcept
+{
+    m_value = std::move(rhs);
+    m_context.assigned_value(m_value);
     return *this;
 }
 
-template <typename T>
-constexpr region<T> & region<T>::operator = (region<T> const & rhs) noexcept
+template <typename T, typename Context>
+constexpr region<T, Context> &
+region<T, Context>::operator = (T const & rhs) noexcept
+{
+    m_value = rhs;
+    m_context.assigned_value(m_value);
+    return *this;
+}
+
+template <typename T, typename Context>
+constexpr region<T, Context> &
+region<T, Context>::operator = (region && rhs) noexcept
+{
+    m_value = std::move(rhs.m_value);
+    m_context.assigned_value(m_value);
+    return *this;
+}
+
+template <typename T, typename Context>
+constexpr region<T, Context> &
+region<T, Context>::operator = (region const & rhs) noexcept
 {
     m_value = rhs.m_value;
-    m_context.created_value(m_value);
+    m_context.assigned_value(m_value);
     return *this;
 }
 
-template <typename T>
-constexpr region<T const &>::region(context & c, T const & value) noexcept :
+template <typename T, typename Context>
+constexpr region<T const &, Context>::region(Context & c,
+                                             T const & value) noexcept :
     m_context(c),
     m_constant(value)
 {
     m_context.created_constant(m_constant);
 }
 
-template <typename T>
-constexpr region<T &>::region(context & c, T & value) noexcept :
+template <typename T, typename Context>
+constexpr region<T &, Context>::region(Context & c, T & value) noexcept :
     m_context(c),
     m_reference(value)
 {
     m_context.created_reference(m_reference);
 }
 
+template <typename T, typename Context>
+constexpr region<T &, Context> &
+region<T &, Context>::operator = (T && rhs) noexcept
+{
+    m_reference = std::move(rhs);
+    m_context.assigned_reference(m_reference);
+    return *this;
+}
+
+template <typename T, typename Context>
+constexpr region<T &, Context> &
+region<T &, Context>::operator = (T const & rhs) noexcept
+{
+    m_reference = rhs;
+    m_context.assigned_reference(m_reference);
+    return *this;
+}
+
+template <typename T>
+region<T, current_context>::region(T && value) noexcept :
+    m_value(std::move(value))
+{
+    if (context * const c = current_context::get())
+    {
+        c->created_value(m_value);
+    }
+}
+
+template <typename T>
+region<T, current_context>::region(T const & value) noexcept :
+    m_value(value)
+{
+    if (context * const c = current_context::get())
+    {
+        c->created_value(m_value);
+    }
+}
+
+template <typename T>
+template <typename... Args>
+region<T, current_context>::region(std::in_place_t,
+                                   Args &&... args) noexcept :
+    m_value(std::forward<Args>(args)...)
+{
+    if (context * const c = current_context::get())
+    {
+        c->created_value(m_value);
+    }
+}
+
+template <typename T>
+region<T, current_context> &
+region<T, current_context>::operator = (T && rhs) noexcept
+{
+    m_value = std::move(rhs);
+    if (context * const c = current_context::get())
+    {
+        c->assigned_value(m_value);
+    }
+    return *this;
+}
+
+template <typename T>
+region<T, current_context> &
+region<T, current_context>::operator = (T const & rhs) noexcept
+{
+    m_value = rhs;
+    if (context * const c = current_context::get())
+    {
+        c->assigned_value(m_value);
+    }
+    return *this;
+}
+
+template <typename T>
+region<T const &, current_context>::region(T const & value) noexcept :
+    m_constant(value)
+{
+    if (context * const c = current_context::get())
+    {
+        c->created_constant(m_constant);
+    }
+}
+
+template <typename T>
+region<T &, current_context>::region(T & value) noexcept :
+    m_reference(value)
+{
+    if (context * const c = current_context::get())
+    {
+        c->created_reference(m_reference);
+    }
+}
+
 template <typename T>
-constexpr region<T &> & region<T &>::operator = (T && rhs) noexcept
+region<T &, current_context> &
+region<T &, current_context>::operator = (T && rhs) noexcept
+{
+    m_reference = std::move(rhs);
+    if (context * const c = current_context::get())
+    {
+        c->assigned_reference(m_reference);
+    }
+    return *this;
+}
+
+template <typename T>
+region<T &, current_context> &
+region<T &, current_context>::operator = (T const & rhs) noexcept
 {
     m_reference = rhs;
-    m_context.created_reference(m_reference);
+    if (context * const c = current_context::get())
+    {
+        c->assigned_reference(m_reference);
+    }
     return *this;
 }
 
+template <typename T>
+region_span<T>::region_span(context & c,
+                            T * const data,
+                            std::size_t const size) noexcept :
+    m_context(c),
+    m_data(data),
+    m_size(size)
+{
+    m_context.created_references(m_data, m_size);
+}
+
+template <typename T>
+template <typename F>
+void region_span<T>::transform(F f) noexcept
+{
+    T * const data = m_data;
+    std::size_t const size = m_size;
+    for (std::size_t i = 0; i < size; ++i)
+    {
+        data[i] = f(data[i]);
+    }
+    m_context.assigned_references(m_data, m_size);
+}
+
+template <typename T>
+template <typename InputIt>
+void region_span<T>::assign(InputIt first) noexcept
+{
+    T * const data = m_data;
+    std::size_t const size = m_size;
+    for (std::size_t i = 0; i < size; ++i, ++first)
+    {
+        data[i] = *first;
+    }
+    m_context.assigned_references(m_data, m_size);
+}
+
+template <typename T>
+void region_span<T>::assign(T const & value) noexcept
+{
+    T * const data = m_data;
+    std::size_t const size = m_size;
+    for (std::size_t i = 0; i < size; ++i)
+    {
+        data[i] = value;
+    }
+    m_context.assigned_references(m_data, m_size);
+}
+
+template <typename T>
+template <typename R, typename F>
+region<R> region_span<T>::reduce(R init, F f) noexcept
+{
+    T const * const data = m_data;
+    std::size_t const size = m_size;
+    for (std::size_t i = 0; i < size; ++i)
+    {
+        init = f(std::move(init), data[i]);
+    }
+    return m_context(std::move(init));
+}
+
+template <typename T, std::size_t N>
+region_array<T, N>::region_array(context & c,
+                                 std::array<T, N> && values) noexcept :
+    m_context(c),
+    m_values(std::move(values))
+{
+    m_context.created_values(m_values.data(), N);
+}
+
+template <typename T, std::size_t N>
+region_array<T, N>::region_array(context & c,
+                                 std::array<T, N> const & values) noexcept :
+    m_context(c),
+    m_values(values)
+{
+    m_context.created_values(m_values.data(), N);
+}
+
+template <typename T, std::size_t N>
+template <typename F>
+void region_array<T, N>::transform(F f) noexcept
+{
+    for (std::size_t i = 0; i < N; ++i)
+    {
+        m_values[i] = f(m_values[i]);
+    }
+    m_context.assigned_values(m_values.data(), N);
+}
+
+template <typename T, std::size_t N>
+template <typename InputIt>
+void region_array<T, N>::assign(InputIt first) noexcept
+{
+    for (std::size_t i = 0; i < N; ++i, ++first)
+    {
+        m_values[i] = *first;
+    }
+    m_context.assigned_values(m_values.data(), N);
+}
+
+template <typename T, std::size_t N>
+void region_array<T, N>::assign(T const & value) noexcept
+{
+    m_values.fill(value);
+    m_context.assigned_values(m_values.data(), N);
+}
+
+template <typename T, std::size_t N>
+template <typename R, typename F>
+region<R> region_array<T, N>::reduce(R init, F f) noexcept
+{
+    for (std::size_t i = 0; i < N; ++i)
+    {
+        init = f(std::move(init), m_values[i]);
+    }
+    return m_context(std::move(init));
+}
+
+template <typename F>
+lazy_region<F>::lazy_region(context & c, F f,
+                            trace_location const & location) noexcept :
+    m_context(c),
+    m_thunk(std::move(f)),
+    m_location(location)
+{
+}
+
+template <typename F>
+typename lazy_region<F>::value_type const & lazy_region<F>::get() const
+{
+    if (! m_value)
+    {
+        m_value.emplace(m_thunk());
+        m_context.trace_at(m_location);
+        m_context.created_value(*m_value);
+    }
+    return *m_value;
+}
+
 } // namespace effects
 
 #endif // EFFECTS_HPP
@@ -0,0 +1,453 @@
+//-*-Mode:C++;coding:utf-8;tab-width:4;c-basic-offset:4;indent-tabs-mode:()-*-
+// ex: set ft=cpp fenc=utf-8 sts=4 ts=4 sw=4 et nomod:
+//
+// MIT License
+//
+// Copyright (c) 2023 Michael Truog <mjtruog at protonmail dot com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the "Software"),
+// to deal in the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+//
+
+
+#ifndef EFFECTS_CONTAINER_HPP
+#define EFFECTS_CONTAINER_HPP
+
+// Containers with the effects tracked for each operation, so the contents
+// are modified in-place (instead of assigning a copy of the container to
+// an effects::region).  Storage allocated by growth (or reallocation) is
+// a kind::write effect, unless the storage is in the context's arena
+// (e.g., with a std::pmr::polymorphic_allocator using the effects::arena)
+// and an operation that may throw (an allocation or a constructor that is
+// not noexcept) is a kind::exception effect.  The element values are
+// tracked like an effects::region_array (for pointers and floating-point).
+// region_vector::reserve allocates once before the elements are added,
+// so adding elements does not allocate (or throw) after reserve.
+
+#include "effects.hpp"
+#include <functional>
+#include <map>
+#include <memory>
+#include <vector>
+
+namespace effects
+{
+
+template <typename T, typename Allocator = std::allocator<T> >
+class region_vector
+{
+    public:
+        static_assert(! std::is_same<T, bool>::value,
+                      "Do not use bool (std::vector<bool> has no data)");
+
+        using vector_type = std::vector<T, Allocator>;
+        using value_type = T;
+        using size_type = typename vector_type::size_type;
+        using allocator_type = Allocator;
+        using const_iterator = typename vector_type::const_iterator;
+
+        explicit region_vector(context & c,
+                               Allocator const & allocator = Allocator())
+            noexcept :
+            m_context(c),
+            m_values(allocator)
+        {
+        }
+
+        region_vector(context & c, vector_type && values) noexcept :
+            m_context(c),
+            m_values(std::move(values))
+        {
+            if (m_values.capacity() > 0)
+            {
+                m_context.allocated(m_values.data());
+            }
+            m_context.created_values(m_values.data(), m_values.size());
+        }
+
+        region_vector(region_vector && o) noexcept = default;
+        region_vector(region_vector const & o) = delete;
+
+        [[nodiscard]] operator vector_type const & () const & noexcept
+        {
+            return m_values;
+        }
+        [[nodiscard]] T const * data() const noexcept
+        {
+            return m_values.data();
+        }
+        [[nodiscard]] size_type size() const noexcept
+        {
+            return m_values.size();
+        }
+        [[nodiscard]] size_type capacity() const noexcept
+        {
+            return m_values.capacity();
+        }
+        [[nodiscard]] bool empty() const noexcept
+        {
+            return m_values.empty();
+        }
+        [[nodiscard]] const_iterator begin() const noexcept
+        {
+            return m_values.begin();
+        }
+        [[nodiscard]] const_iterator end() const noexcept
+        {
+            return m_values.end();
+        }
+        [[nodiscard]] T const & operator [](size_type const i)
+            const noexcept
+        {
+            return m_values[i];
+        }
+        [[nodiscard]] allocator_type get_allocator() const noexcept
+        {
+            return m_values.get_allocator();
+        }
+
+        void reserve(size_type const size)
+        {
+            if (size > m_values.capacity())
+            {
+                m_context.set_exception();
+                m_values.reserve(size);
+                m_context.allocated(m_values.data());
+            }
+        }
+
+        template <typename... Args>
+        T const & emplace_back(Args &&... args)
+        {
+            growing<Args &&...>(m_values.size() + 1);
+            T const * const data = m_values.data();
+            T const & value =
+                m_values.emplace_back(std::forward<Args>(args)...);
+            grown(data);
+            m_context.assigned_value(value);
+            return value;
+        }
+        void push_back(T const & value)
+        {
+            emplace_back(value);
+        }
+        void push_back(T && value)
+        {
+            emplace_back(std::move(value));
+        }
+
+        void resize(size_type const size)
+        {
+            growing<>(size);
+            T const * const data = m_values.data();
+            m_values.resize(size);
+            grown(data);
+            m_context.assigned_values(m_values.data(), m_values.size());
+        }
+        void resize(size_type const size, T const & value)
+        {
+            growing<T const &>(size);
+            T const * const data = m_values.data();
+            m_values.resize(size, value);
+            grown(data);
+            m_context.assigned_values(m_values.data(), m_values.size());
+        }
+
+        void pop_back() noexcept
+        {
+            m_values.pop_back();
+        }
+        void clear() noexcept
+        {
+            m_values.clear();
+        }
+
+        // in-place f(element) for element i
+        template <typename F>
+        void modify(size_type const i, F f)
+        {
+            if constexpr (! std::is_nothrow_invocable_v<F &, T &>)
+            {
+                m_context.set_exception();
+            }
+            T & value = m_values[i];
+            f(value);
+            m_context.assigned_value(value);
+        }
+
+        // element-wise in-place element = f(element)
+        template <typename F>
+        void transform(F f)
+        {
+            if constexpr (! std::is_nothrow_invocable_v<F &, T &>)
+            {
+                m_context.set_exception();
+            }
+            T * const data = m_values.data();
+            size_type const size = m_values.size();
+            for (size_type i = 0; i < size; ++i)
+            {
+                data[i] = f(data[i]);
+            }
+            m_context.assigned_values(data, size);
+        }
+
+        // in-place f(vector) for any other std::vector operations
+        template <typename F>
+        void apply(F f)
+        {
+            if constexpr (! std::is_nothrow_invocable_v<F &, vector_type &>)
+            {
+                m_context.set_exception();
+            }
+            T const * const data = m_values.data();
+            f(m_values);
+            grown(data);
+            m_context.assigned_values(m_values.data(), m_values.size());
+        }
+
+        // the std::vector without the region
+        [[nodiscard]] vector_type release() && noexcept
+        {
+            return std::move(m_values);
+        }
+
+    private:
+        template <typename... Args>
+        void growing(size_type const size) noexcept
+        {
+            // an allocation (or constructor) may throw
+            if (size > m_values.capacity() ||
+                ! std::is_nothrow_constructible_v<T, Args...>)
+            {
+                m_context.set_exception();
+            }
+        }
+
+        void grown(T const * const data) noexcept
+        {
+            if (m_values.data() != data)
+            {
+                m_context.allocated(m_values.data());
+            }
+        }
+
+        context & m_context;
+        vector_type m_values;
+};
+
+template <typename Key, typename T, typename Compare = std::less<Key>,
+          typename Allocator =
+              std::allocator< std::pair<Key const, T> > >
+class region_map
+{
+    public:
+        using map_type = std::map<Key, T, Compare, Allocator>;
+        using key_type = Key;
+        using mapped_type = T;
+        using value_type = typename map_type::value_type;
+        using size_type = typename map_type::size_type;
+        using allocator_type = Allocator;
+        using const_iterator = typename map_type::const_iterator;
+
+        explicit region_map(context & c,
+                            Compare const & compare = Compare(),
+                            Allocator const & allocator = Allocator())
+            noexcept :
+            m_context(c),
+            m_values(compare, allocator)
+        {
+        }
+
+        region_map(context & c, map_type && values) noexcept :
+            m_context(c),
+            m_values(std::move(values))
+        {
+            for (value_type const & value : m_values)
+            {
+                created(value);
+            }
+        }
+
+        region_map(region_map && o) noexcept = default;
+        region_map(region_map const & o) = delete;
+
+        [[nodiscard]] operator map_type const & () const & noexcept
+        {
+            return m_values;
+        }
+        [[nodiscard]] size_type size() const noexcept
+        {
+            return m_values.size();
+        }
+        [[nodiscard]] bool empty() const noexcept
+        {
+            return m_values.empty();
+        }
+        [[nodiscard]] const_iterator begin() const noexcept
+        {
+            return m_values.begin();
+        }
+        [[nodiscard]] const_iterator end() const noexcept
+        {
+            return m_values.end();
+        }
+        [[nodiscard]] const_iterator find(Key const & key) const
+        {
+            return m_values.find(key);
+        }
+        [[nodiscard]] bool contains(Key const & key) const
+        {
+            return m_values.find(key) != m_values.end();
+        }
+        [[nodiscard]] T const & at(Key const & key) const
+        {
+            // std::out_of_range may be thrown
+            m_context.set_exception();
+            return m_values.at(key);
+        }
+        [[nodiscard]] allocator_type get_allocator() const noexcept
+        {
+            return m_values.get_allocator();
+        }
+
+        template <typename... Args>
+        std::pair<const_iterator, bool> emplace(Args &&... args)
+        {
+            // each element is a node allocation that may throw
+            m_context.set_exception();
+            auto const result =
+                m_values.emplace(std::forward<Args>(args)...);
+            if (result.second)
+            {
+                inserted(*result.first);
+            }
+            return result;
+        }
+        std::pair<const_iterator, bool> insert(value_type const & value)
+        {
+            return emplace(value);
+        }
+        std::pair<const_iterator, bool> insert(value_type && value)
+        {
+            return emplace(std::move(value));
+        }
+
+        template <typename... Args>
+        std::pair<const_iterator, bool> try_emplace(Key const & key,
+                                                    Args &&... args)
+        {
+            m_context.set_exception();
+            auto const result =
+                m_values.try_emplace(key, std::forward<Args>(args)...);
+            if (result.second)
+            {
+                inserted(*result.first);
+            }
+            return result;
+        }
+
+        template <typename M>
+        std::pair<const_iterator, bool> insert_or_assign(Key const & key,
+                                                         M && mapped)
+        {
+            m_context.set_exception();
+            auto const result =
+                m_values.insert_or_assign(key, std::forward<M>(mapped));
+            if (result.second)
+            {
+                inserted(*result.first);
+            }
+            else
+            {
+                m_context.assigned_value(result.first->second);
+            }
+            return result;
+        }
+
+        size_type erase(Key const & key)
+        {
+            return m_values.erase(key);
+        }
+        void clear() noexcept
+        {
+            m_values.clear();
+        }
+
+        // in-place f(mapped) for the key (false if the key is not found)
+        template <typename F>
+        bool modify(Key const & key, F f)
+        {
+            if constexpr (! std::is_nothrow_invocable_v<F &, T &>)
+            {
+                m_context.set_exception();
+            }
+            auto const found = m_values.find(key);
+            if (found == m_values.end())
+            {
+                return false;
+            }
+            f(found->second);
+            m_context.assigned_value(found->second);
+            return true;
+        }
+
+        // element-wise in-place mapped = f(key, mapped)
+        template <typename F>
+        void transform(F f)
+        {
+            if constexpr (! std::is_nothrow_invocable_v<F &, Key const &,
+                                                        T &>)
+            {
+                m_context.set_exception();
+            }
+            for (value_type & value : m_values)
+            {
+                value.second = f(value.first, value.second);
+                m_context.assigned_value(value.second);
+            }
+        }
+
+        // the std::map without the region
+        [[nodiscard]] map_type release() && noexcept
+        {
+            return std::move(m_values);
+        }
+
+    private:
+        void created(value_type const & value) noexcept
+        {
+            m_context.allocated(&value);
+            m_context.created_value(value.first);
+            m_context.created_value(value.second);
+        }
+
+        void inserted(value_type const & value) noexcept
+        {
+            m_context.allocated(&value);
+            m_context.assigned_value(value.first);
+            m_context.assigned_value(value.second);
+        }
+
+        context & m_context;
+        map_type m_values;
+};
+
+} // namespace effects
+
+#endif // EFFECTS_CONTAINER_HPP
@@ -0,0 +1,399 @@
+//-*-Mode:C++;coding:utf-8;tab-width:4;c-basic-offset:4;indent-tabs-mode:()-*-
+// ex: set ft=cpp fenc=utf-8 sts=4 ts=4 sw=4 et nomod:
+//
+// MIT License
+//
+// Copyright (c) 2023 Michael Truog <mjtruog at protonmail dot com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the "Software"),
+// to deal in the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+//
+
+
+#ifndef EFFECTS_COROUTINE_HPP
+#define EFFECTS_COROUTINE_HPP
+
+// Effect tracking for C++20 coroutines.
+// A coroutine returning an effects::task<T> uses the effects::context
+// that is its first parameter (after the object parameter of a lambda or
+// member function).  Each part of the coroutine executed by a thread
+// (between suspensions) saves and clears the FE_* flags of the thread
+// when it starts and samples the FE_* flags into the context and
+// restores the FE_* flags of the thread when it suspends,
+// so the FPE are always captured on the thread that resumed the coroutine.
+// The context is also the effects::current_context while the
+// coroutine executes.
+
+#include "effects.hpp"
+#if ! defined(CXX20) || ! __has_include(<coroutine>)
+#error "C++20 coroutines are required"
+#endif
+#include <coroutine>
+#include <condition_variable>
+#include <exception>
+#include <mutex>
+#include <optional>
+#include <utility>
+
+namespace effects
+{
+
+template <typename T> class task;
+
+namespace coroutine
+{
+
+// context state for the part of the coroutine executed by a thread
+class segment
+{
+    public:
+        explicit segment(context & c) noexcept :
+            m_context(c),
+            m_flags(),
+            m_attached(false)
+        {
+        }
+
+        [[nodiscard]] context & get() noexcept
+        {
+            return m_context;
+        }
+
+        void attach() noexcept
+        {
+            if (m_attached)
+            {
+                return;
+            }
+            m_attached = true;
+            std::fegetexceptflag(&m_flags, segment::fpe_all);
+            std::feclearexcept(segment::fpe_all);
+            m_current.emplace(m_context);
+        }
+
+        void detach() noexcept
+        {
+            if (! m_attached)
+            {
+                return;
+            }
+            m_attached = false;
+            m_current.reset();
+            m_context.sample();
+            std::fesetexceptflag(&m_flags, segment::fpe_all);
+        }
+
+    private:
+        static constexpr int fpe_all = FE_INVALID | FE_DIVBYZERO |
+                                       FE_OVERFLOW | FE_UNDERFLOW |
+                                       FE_INEXACT;
+
+        context & m_context;
+        std::fexcept_t m_flags;
+        std::optional<current_context> m_current;
+        bool m_attached;
+};
+
+// awaiter that detaches the segment when the coroutine suspends and
+// attaches the segment when the coroutine resumes
+template <typename Awaiter>
+class awaiter
+{
+    public:
+        awaiter(segment & s, Awaiter && a) noexcept :
+            m_segment(s),
+            m_awaiter(std::forward<Awaiter>(a))
+        {
+        }
+
+        bool await_ready()
+        {
+            return m_awaiter.await_ready();
+        }
+
+        template <typename Promise>
+        auto await_suspend(std::coroutine_handle<Promise> h)
+        {
+            // the coroutine may be resumed by a different thread
+            // before await_suspend returns
+            m_segment.detach();
+            return m_awaiter.await_suspend(h);
+        }
+
+        decltype(auto) await_resume()
+        {
+            m_segment.attach();
+            return m_awaiter.await_resume();
+        }
+
+    private:
+        segment & m_segment;
+        Awaiter m_awaiter;
+};
+
+template <typename T>
+[[nodiscard]] decltype(auto) get_awaiter(T && value)
+{
+    if constexpr (requires { std::forward<T>(value).operator co_await(); })
+    {
+        return std::forward<T>(value).operator co_await();
+    }
+    else if constexpr (requires { operator co_await(std::forward<T>(value)); })
+    {
+        return operator co_await(std::forward<T>(value));
+    }
+    else
+    {
+        return std::forward<T>(value);
+    }
+}
+
+// when the synchronous wait for a task completes
+class completion
+{
+    public:
+        void set() noexcept
+        {
+            // the waiting thread can not continue before the lock is
+            // released, so the coroutine frame remains valid until then
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_done = true;
+            m_condition.notify_one();
+        }
+
+        void wait() noexcept
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_condition.wait(lock, [this]() { return m_done; });
+        }
+
+    private:
+        std::mutex m_mutex;
+        std::condition_variable m_condition;
+        bool m_done = false;
+};
+
+class promise_base
+{
+    public:
+        template <typename... Args>
+        explicit promise_base(context & c, Args const &...) noexcept :
+            m_segment(c)
+        {
+        }
+        template <typename Self, typename... Args>
+        explicit promise_base(Self const &, context & c,
+                              Args const &...) noexcept :
+            m_segment(c)
+        {
+        }
+
+        auto initial_suspend() noexcept
+        {
+            struct initial_awaiter
+            {
+                segment & m_segment;
+                bool await_ready() const noexcept
+                {
+                    return false;
+                }
+                void await_suspend(std::coroutine_handle<>) const noexcept
+                {
+                }
+                void await_resume() const noexcept
+                {
+                    m_segment.attach();
+                }
+            };
+            return initial_awaiter{m_segment};
+        }
+
+        auto final_suspend() noexcept
+        {
+            struct final_awaiter
+            {
+                promise_base & m_promise;
+                bool await_ready() const noexcept
+                {
+                    return false;
+                }
+                std::coroutine_handle<> await_suspend(
+                    std::coroutine_handle<>) const noexcept
+                {
+                    m_promise.m_segment.detach();
+                    std::coroutine_handle<> const continuation =
+                        m_promise.m_continuation;
+                    if (m_promise.m_completion != nullptr)
+                    {
+                        m_promise.m_completion->set();
+                    }
+                    return continuation;
+                }
+                void await_resume() const noexcept
+                {
+                }
+            };
+            return final_awaiter{*this};
+        }
+
+        template <typename Awaitable>
+        auto await_transform(Awaitable && a)
+        {
+            using awaiter_type =
+                decltype(coroutine::get_awaiter(std::forward<Awaitable>(a)));
+            return awaiter<awaiter_type>(
+                m_segment,
+                coroutine::get_awaiter(std::forward<Awaitable>(a)));
+        }
+
+        void unhandled_exception() noexcept
+        {
+            m_segment.get().set_exception();
+            m_exception = std::current_exception();
+        }
+
+    protected:
+        template <typename> friend class effects::task;
+
+        segment m_segment;
+        std::coroutine_handle<> m_continuation = std::noop_coroutine();
+        completion * m_completion = nullptr;
+        std::exception_ptr m_exception;
+};
+
+template <typename T>
+class promise_result
+{
+    public:
+        template <typename U>
+        void return_value(U && value)
+        {
+            m_value.emplace(std::forward<U>(value));
+        }
+
+        [[nodiscard]] T value()
+        {
+            return std::move(*m_value);
+        }
+
+    private:
+        std::optional<T> m_value;
+};
+
+template <>
+class promise_result<void>
+{
+    public:
+        void return_void() noexcept
+        {
+        }
+
+        void value() noexcept
+        {
+        }
+};
+
+} // namespace coroutine
+
+// coroutine result with effects tracked in a context
+template <typename T>
+class [[nodiscard]] task
+{
+    public:
+        class promise_type : public coroutine::promise_base,
+                             public coroutine::promise_result<T>
+        {
+            public:
+                using coroutine::promise_base::promise_base;
+
+                task get_return_object() noexcept
+                {
+                    return task(handle_type::from_promise(*this));
+                }
+        };
+
+        task(task && o) noexcept :
+            m_handle(std::exchange(o.m_handle, nullptr))
+        {
+        }
+        task(task const & o) = delete;
+        ~task()
+        {
+            if (m_handle)
+            {
+                m_handle.destroy();
+            }
+        }
+
+        auto operator co_await() && noexcept
+        {
+            struct continuation
+            {
+                handle_type m_handle;
+                bool await_ready() const noexcept
+                {
+                    return false;
+                }
+                std::coroutine_handle<> await_suspend(
+                    std::coroutine_handle<> h) const noexcept
+                {
+                    m_handle.promise().m_continuation = h;
+                    return m_handle;
+                }
+                T await_resume() const
+                {
+                    return task::result(m_handle);
+                }
+            };
+            return continuation{m_handle};
+        }
+
+        // execute the coroutine and wait for the coroutine to complete
+        T get() &&
+        {
+            coroutine::completion done;
+            m_handle.promise().m_completion = &done;
+            m_handle.resume();
+            done.wait();
+            return task::result(m_handle);
+        }
+
+    private:
+        using handle_type = std::coroutine_handle<promise_type>;
+
+        explicit task(handle_type h) noexcept :
+            m_handle(h)
+        {
+        }
+
+        static T result(handle_type h)
+        {
+            promise_type & promise = h.promise();
+            if (promise.m_exception)
+            {
+                std::rethrow_exception(promise.m_exception);
+            }
+            return promise.value();
+        }
+
+        handle_type m_handle;
+};
+
+} // namespace effects
+
+#endif // EFFECTS_COROUTINE_HPP
@@ -0,0 +1,187 @@
+//-*-Mode:C++;coding:utf-8;tab-width:4;c-basic-offset:4;indent-tabs-mode:()-*-
+// ex: set ft=cpp fenc=utf-8 sts=4 ts=4 sw=4 et nomod:
+//
+// MIT License
+//
+// Copyright (c) 2023 Michael Truog <mjtruog at protonmail dot com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the "Software"),
+// to deal in the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+//
+
+
+#ifndef EFFECTS_ENVIRONMENT_HPP
+#define EFFECTS_ENVIRONMENT_HPP
+
+// A probe of the execution environment, done once for each process
+// (when first used) with the result shared read-only by all threads.
+// The probe reads the CPU features (with cpuid on x86) and the
+// floating-point control register of the probing thread, so install
+// provides kind::variation_hardware for all floating-point regions if
+// flush-to-zero (FTZ) or denormals-are-zero (DAZ) is enabled
+// (subnormal values are not IEEE 754 results).  The type-derived
+// variation effects (e.g., for long) are provided by effects::kind_variation.
+
+#include "effects.hpp"
+#include <climits>
+#if defined(__x86_64__) || defined(__i386__) || \
+    defined(_M_X64) || defined(_M_IX86)
+#define EFFECTS_ENVIRONMENT_X86
+#include <xmmintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#endif
+
+namespace effects
+{
+
+namespace environment
+{
+
+struct features
+{
+    // CPU features (usable with the OS)
+    bool fma = false;
+    bool avx2 = false;
+    bool avx512f = false;
+    // floating-point control state
+    bool flush_to_zero = false;
+    bool denormals_are_zero = false;
+    // OS conventions
+    std::size_t long_bits = sizeof(long) * CHAR_BIT;
+    std::size_t wchar_bits = sizeof(wchar_t) * CHAR_BIT;
+#if defined(_WIN32)
+    char path_separator = '\\';
+#else
+    char path_separator = '/';
+#endif
+    // variation effects for floating-point use
+    unsigned int kind_floating_point = kind::pure;
+};
+
+#if defined(EFFECTS_ENVIRONMENT_X86)
+namespace x86
+{
+
+// MXCSR bits
+constexpr unsigned int mxcsr_daz = 0x0040;
+constexpr unsigned int mxcsr_ftz = 0x8000;
+
+// registers eax, ebx, ecx, edx of cpuid
+inline bool cpuid(unsigned int const leaf, unsigned int const subleaf,
+                  unsigned int (&registers)[4]) noexcept
+{
+#if defined(_MSC_VER)
+    int values[4];
+    __cpuidex(values, static_cast<int>(leaf), static_cast<int>(subleaf));
+    for (std::size_t i = 0; i < 4; ++i)
+    {
+        registers[i] = static_cast<unsigned int>(values[i]);
+    }
+    return true;
+#else
+    return __get_cpuid_count(leaf, subleaf, &registers[0], &registers[1],
+                             &registers[2], &registers[3]) != 0;
+#endif
+}
+
+// extended control register 0 (the register state saved by the OS)
+inline std::uint64_t xcr0() noexcept
+{
+#if defined(_MSC_VER)
+    return _xgetbv(0);
+#else
+    unsigned int eax;
+    unsigned int edx;
+    asm volatile("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+    return (static_cast<std::uint64_t>(edx) << 32) | eax;
+#endif
+}
+
+inline void detect(features & result) noexcept
+{
+    unsigned int registers[4] = {0, 0, 0, 0};
+    if (! cpuid(0, 0, registers))
+    {
+        return;
+    }
+    unsigned int const leaf_max = registers[0];
+    cpuid(1, 0, registers);
+    bool const fma = (registers[2] >> 12) & 1;
+    bool const osxsave = (registers[2] >> 27) & 1;
+    bool const avx = (registers[2] >> 28) & 1;
+    std::uint64_t const xcr0 = osxsave ? x86::xcr0() : 0;
+    // XMM and YMM state (and opmask, ZMM state for AVX-512)
+    bool const ymm = (xcr0 & 0x06) == 0x06;
+    bool const zmm = (xcr0 & 0xe6) == 0xe6;
+    result.fma = fma && avx && ymm;
+    if (leaf_max >= 7)
+    {
+        cpuid(7, 0, registers);
+        result.avx2 = ((registers[1] >> 5) & 1) && ymm;
+        result.avx512f = ((registers[1] >> 16) & 1) && zmm;
+    }
+    unsigned int const mxcsr = _mm_getcsr();
+    result.flush_to_zero = (mxcsr & mxcsr_ftz) != 0;
+    result.denormals_are_zero = (mxcsr & mxcsr_daz) != 0;
+}
+
+} // namespace x86
+#endif
+
+[[nodiscard]] inline features detect() noexcept
+{
+    features result;
+#if defined(EFFECTS_ENVIRONMENT_X86)
+    x86::detect(result);
+#elif defined(__aarch64__) && defined(__GNUC__)
+    // FPCR.FZ flushes subnormal values to zero
+    std::uint64_t fpcr;
+    asm volatile("mrs %0, fpcr" : "=r"(fpcr));
+    result.flush_to_zero = (fpcr >> 24) & 1;
+    result.fma = true;
+#endif
+    if (result.flush_to_zero || result.denormals_are_zero)
+    {
+        result.kind_floating_point |= kind::variation_hardware;
+    }
+    return result;
+}
+
+// the probe result, created once for each process
+[[nodiscard]] inline features const & probe() noexcept
+{
+    static features const result = detect();
+    return result;
+}
+
+// floating-point regions have the variation effects of the probe result
+inline void install() noexcept
+{
+    floating_point_variation.store(probe().kind_floating_point,
+                                   std::memory_order_relaxed);
+}
+
+} // namespace environment
+
+} // namespace effects
+
+#endif // EFFECTS_ENVIRONMENT_HPP
@@ -0,0 +1,108 @@
+//-*-Mode:C++;coding:utf-8;tab-width:4;c-basic-offset:4;indent-tabs-mode:()-*-
+// ex: set ft=cpp fenc=utf-8 sts=4 ts=4 sw=4 et nomod:
+//
+// MIT License
+//
+// Copyright (c) 2023 Michael Truog <mjtruog at protonmail dot com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the "Software"),
+// to deal in the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+//
+
+
+#ifndef EFFECTS_EXCEPTION_HPP
+#define EFFECTS_EXCEPTION_HPP
+
+// An interposer of the C++ runtime's __cxa_throw function records each
+// thrown C++ exception (including exceptions thrown by libraries) as a
+// kind::exception effect in the context of the most recent
+// effects::current_context object in the thread, so set_exception is not
+// called for each throw.  The interposer is defined by the translation unit
+// that defines EFFECTS_EXCEPTION_INTERPOSE before including this header
+// (only one translation unit in the executable may define it)
+// and it calls the C++ runtime's __cxa_throw (found with dlsym).
+// A thread without a current_context object is not tracked, so
+// effects::guarded is used for a specific context.
+
+#include "effects.hpp"
+#include <typeinfo>
+
+#if defined(__GXX_ABI_VERSION) && defined(__GLIBC__)
+#define EFFECTS_EXCEPTION_INTERPOSER_ENABLED
+#include <cstdio>
+#include <cstdlib>
+#include <cxxabi.h>
+#include <dlfcn.h>
+#endif
+
+namespace effects
+{
+
+namespace exception
+{
+
+// record the exception being thrown in the current context
+inline void thrown() noexcept
+{
+    context * const c = current_context::get();
+    if (c != nullptr)
+    {
+        c->set_exception();
+    }
+}
+
+#if defined(EFFECTS_EXCEPTION_INTERPOSER_ENABLED)
+using cxa_throw_t = void (*)(void *, std::type_info *, void (*)(void *));
+
+// the C++ runtime's __cxa_throw function
+inline cxa_throw_t cxa_throw() noexcept
+{
+    static cxa_throw_t const f =
+        reinterpret_cast<cxa_throw_t>(::dlsym(RTLD_NEXT, "__cxa_throw"));
+    if (f == nullptr)
+    {
+        // e.g., a static executable (without the dynamic C++ runtime)
+        std::fputs("effects: __cxa_throw of the C++ runtime not found\n",
+                   stderr);
+        std::abort();
+    }
+    return f;
+}
+#endif
+
+} // namespace exception
+
+} // namespace effects
+
+#if defined(EFFECTS_EXCEPTION_INTERPOSE) && \
+    defined(EFFECTS_EXCEPTION_INTERPOSER_ENABLED)
+// (the declaration is provided by cxxabi.h)
+namespace __cxxabiv1
+{
+extern "C" void __cxa_throw(void * thrown_exception,
+                            std::type_info * type,
+                            void (*destructor)(void *))
+{
+    ::effects::exception::thrown();
+    ::effects::exception::cxa_throw()(thrown_exception, type, destructor);
+    __builtin_unreachable();
+}
+} // namespace __cxxabiv1
+#endif
+
+#endif // EFFECTS_EXCEPTION_HPP
@@ -0,0 +1,257 @@
+//-*-Mode:C++;coding:utf-8;tab-width:4;c-basic-offset:4;indent-tabs-mode:()-*-
+// ex: set ft=cpp fenc=utf-8 sts=4 ts=4 sw=4 et nomod:
+//
+// MIT License
+//
+// Copyright (c) 2023 Michael Truog <mjtruog at protonmail dot com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the "Software"),
+// to deal in the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+//
+
+
+#ifndef EFFECTS_MEMOIZE_HPP
+#define EFFECTS_MEMOIZE_HPP
+
+// Memoization of functions verified as referentially transparent.
+// The function is called with a child context and the result is only
+// cached if the child context effects are cacheable (kind::pure by default),
+// so an impure result is never cached.
+// The cache is a sharded open-addressing hash table with a fixed capacity,
+// a bounded probe window and CLOCK eviction within the probe window
+// (each shard has a separate lock, that is not held while the function
+//  is called, so recursive memoized functions are supported).
+
+#include "effects.hpp"
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <tuple>
+#include <vector>
+
+namespace effects
+{
+
+template <typename F, typename... Args>
+class memoized
+{
+    public:
+        using key_type = std::tuple< std::decay_t<Args>... >;
+        using result_type =
+            std::decay_t< std::invoke_result_t<F &, context &,
+                                               Args const &...> >;
+
+        static constexpr std::size_t shards = 16;
+        static constexpr std::size_t probes = 8;
+
+        memoized(F f, unsigned int const kind_cacheable,
+                 std::size_t const capacity) :
+            m_f(std::move(f)),
+            m_kind_cacheable(kind_cacheable & kind::bitmask)
+        {
+            // each shard has a power of 2 number of slots
+            // (the capacity is rounded up to a multiple of shards)
+            std::size_t slots = 1;
+            while (slots * shards < capacity)
+            {
+                slots *= 2;
+            }
+            for (shard & s : m_shards)
+            {
+                s.slots.resize(slots);
+            }
+        }
+
+        memoized(memoized const & o) = delete;
+
+        result_type operator()(context & c, Args const &... args)
+        {
+            key_type key(args...);
+            std::size_t const hash = memoized::hash_key(key);
+            shard & s = m_shards[hash % shards];
+            {
+                std::lock_guard<std::mutex> lock(s.mutex);
+                if (slot * const found = s.find(hash, key))
+                {
+                    ++s.hits;
+                    found->referenced = true;
+                    c.merge(found->kind);
+                    return *found->result;
+                }
+                ++s.misses;
+            }
+            child_context c_f = c.child(m_kind_cacheable);
+            result_type result = m_f(c_f, args...);
+            // FE_* flags set by f without a region are effects of f
+            c_f.sample();
+            unsigned int const kind = c_f.kind();
+            if ((kind & kind::bitmask & ~m_kind_cacheable) == 0)
+            {
+                std::lock_guard<std::mutex> lock(s.mutex);
+                s.insert(hash, std::move(key), result, kind);
+            }
+            return result;
+        }
+
+        [[nodiscard]] std::size_t hits() noexcept
+        {
+            return sum(&shard::hits);
+        }
+
+        [[nodiscard]] std::size_t misses() noexcept
+        {
+            return sum(&shard::misses);
+        }
+
+        [[nodiscard]] std::size_t capacity() const noexcept
+        {
+            return m_shards[0].slots.size() * shards;
+        }
+
+        void clear() noexcept
+        {
+            for (shard & s : m_shards)
+            {
+                std::lock_guard<std::mutex> lock(s.mutex);
+                for (slot & entry : s.slots)
+                {
+                    entry = slot();
+                }
+            }
+        }
+
+    private:
+        struct slot
+        {
+            std::size_t hash = 0;
+            std::optional<key_type> key;
+            std::optional<result_type> result;
+            unsigned int kind = kind::pure;
+            bool referenced = false;
+        };
+
+        struct alignas(cache_line_size) shard
+        {
+            std::mutex mutex;
+            std::vector<slot> slots;
+            std::size_t hand = 0;
+            std::size_t hits = 0;
+            std::size_t misses = 0;
+
+            std::size_t index(std::size_t const hash,
+                              std::size_t const probe) const noexcept
+            {
+                return (hash / shards + probe) & (slots.size() - 1);
+            }
+
+            slot * find(std::size_t const hash, key_type const & key)
+            {
+                for (std::size_t probe = 0; probe < probes; ++probe)
+                {
+                    slot & entry = slots[index(hash, probe)];
+                    if (entry.key && entry.hash == hash && *entry.key == key)
+                    {
+                        return &entry;
+                    }
+                }
+                return nullptr;
+            }
+
+            void insert(std::size_t const hash, key_type && key,
+                        result_type const & result, unsigned int const kind)
+            {
+                slot * victim = find(hash, key);
+                for (std::size_t probe = 0;
+                     victim == nullptr && probe < probes; ++probe)
+                {
+                    slot & entry = slots[index(hash, probe)];
+                    if (! entry.key)
+                    {
+                        victim = &entry;
+                    }
+                }
+                // CLOCK eviction within the probe window
+                while (victim == nullptr)
+                {
+                    slot & entry = slots[index(hash, hand)];
+                    hand = (hand + 1) % probes;
+                    if (entry.referenced)
+                    {
+                        entry.referenced = false;
+                    }
+                    else
+                    {
+                        victim = &entry;
+                    }
+                }
+                victim->hash = hash;
+                victim->key.emplace(std::move(key));
+                victim->result.emplace(result);
+                victim->kind = kind;
+                victim->referenced = false;
+            }
+        };
+
+        static std::size_t hash_key(key_type const & key)
+        {
+            return std::apply([](auto const &... values) {
+                std::size_t hash = 0;
+                static_cast<void>((
+                    (hash ^= std::hash< std::decay_t<decltype(values)> >{}(
+                        values) + 0x9e3779b97f4a7c15ULL +
+                        (hash << 6) + (hash >> 2)), ...));
+                // mix the bits to avoid identity hashes of integers
+                hash ^= hash >> 33;
+                hash *= 0xff51afd7ed558ccdULL;
+                hash ^= hash >> 33;
+                return hash;
+            }, key);
+        }
+
+        std::size_t sum(std::size_t shard::* const counter) noexcept
+        {
+            std::size_t total = 0;
+            for (shard & s : m_shards)
+            {
+                std::lock_guard<std::mutex> lock(s.mutex);
+                total += s.*counter;
+            }
+            return total;
+        }
+
+        F m_f;
+        unsigned int const m_kind_cacheable;
+        std::array<shard, shards> m_shards;
+};
+
+// memoize f(context &, Args const &...) for results with
+// effects that are cacheable
+// (the capacity is rounded up to a power of 2 slots for each of the
+//  memoized::shards, so the minimum capacity is memoized::shards)
+template <typename... Args, typename F>
+[[nodiscard]] memoized<F, Args...> memoize(
+    F f,
+    unsigned int const kind_cacheable = kind::pure,
+    std::size_t const capacity = 1024)
+{
+    return memoized<F, Args...>(std::move(f), kind_cacheable, capacity);
+}
+
+} // namespace effects
+
+#endif // EFFECTS_MEMOIZE_HPP
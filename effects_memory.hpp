@@ -0,0 +1,241 @@
+//-*-Mode:C++;coding:utf-8;tab-width:4;c-basic-offset:4;indent-tabs-mode:()-*-
+// ex: set ft=cpp fenc=utf-8 sts=4 ts=4 sw=4 et nomod:
+//
+// MIT License
+//
+// Copyright (c) 2023 Michael Truog <mjtruog at protonmail dot com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the "Software"),
+// to deal in the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+//
+
+
+#ifndef EFFECTS_MEMORY_HPP
+#define EFFECTS_MEMORY_HPP
+
+// Pointer ownership classification using address ranges.
+// The loaded segments (of the executable and shared libraries) are read
+// once, when first used, into a sorted table that is shared read-only
+// by all threads, so each classification is a check of the current
+// thread stack bounds and a binary search of the table.
+// Shared libraries loaded after the table is created are classified
+// as heap memory.
+
+#include "effects.hpp"
+#include <algorithm>
+#include <vector>
+#if defined(__linux__)
+#include <link.h>
+#include <pthread.h>
+#endif
+
+namespace effects
+{
+
+namespace memory
+{
+
+enum struct ownership
+{
+    heap,           // kind::write
+    static_data,    // kind::write (writable segment)
+    read_only,      // read-only segment (e.g., .rodata or .text)
+    stack           // current thread stack
+};
+
+// immutable table of loaded segment address ranges
+class range_table
+{
+    public:
+        range_table(range_table const & o) = delete;
+
+        [[nodiscard]] static range_table const & get() noexcept
+        {
+            static range_table const table;
+            return table;
+        }
+
+        [[nodiscard]] ownership find(std::uintptr_t const address)
+            const noexcept
+        {
+            std::size_t size = m_ranges.size();
+            if (size == 0)
+            {
+                return ownership::heap;
+            }
+            // find the last range that begins before the address
+            range const * base = m_ranges.data();
+            while (size > 1)
+            {
+                std::size_t const half = size / 2;
+                base = (base[half].begin <= address) ? base + half : base;
+                size -= half;
+            }
+            if (address - base->begin >= base->end - base->begin)
+            {
+                return ownership::heap;
+            }
+            return base->writable ? ownership::static_data :
+                                    ownership::read_only;
+        }
+
+        [[nodiscard]] std::size_t size() const noexcept
+        {
+            return m_ranges.size();
+        }
+
+    private:
+        struct range
+        {
+            std::uintptr_t begin;
+            std::uintptr_t end;
+            bool writable;
+        };
+
+        range_table() noexcept
+        {
+#if defined(__linux__)
+            // (no exception is thrown through the C frames of glibc while
+            //  the loader lock is held, so segments stops the iteration)
+            iteration state{m_ranges, false};
+            dl_iterate_phdr(range_table::segments, &state);
+            if (state.failed)
+            {
+                // all memory is classified as heap memory
+                m_ranges.clear();
+                return;
+            }
+            std::sort(m_ranges.begin(), m_ranges.end(),
+                      [](range const & a, range const & b) {
+                return a.begin < b.begin;
+            });
+#endif
+        }
+
+#if defined(__linux__)
+        struct iteration
+        {
+            std::vector<range> & ranges;
+            bool failed;
+        };
+
+        static int segments(struct dl_phdr_info * info, std::size_t,
+                            void * data) noexcept
+        {
+            iteration & state = *static_cast<iteration *>(data);
+            for (ElfW(Half) i = 0; i < info->dlpi_phnum; ++i)
+            {
+                ElfW(Phdr) const & header = info->dlpi_phdr[i];
+                if (header.p_type != PT_LOAD || header.p_memsz == 0)
+                {
+                    continue;
+                }
+                std::uintptr_t const begin = info->dlpi_addr +
+                                             header.p_vaddr;
+                try
+                {
+                    state.ranges.push_back({begin, begin + header.p_memsz,
+                                            (header.p_flags & PF_W) != 0});
+                }
+                catch (...)
+                {
+                    // a non-zero result stops the iteration
+                    state.failed = true;
+                    return 1;
+                }
+            }
+            return 0;
+        }
+#endif
+
+        std::vector<range> m_ranges;
+};
+
+// stack address range of the current thread
+class stack_bounds
+{
+    public:
+        stack_bounds(stack_bounds const & o) = delete;
+
+        [[nodiscard]] static stack_bounds const & get() noexcept
+        {
+            static thread_local stack_bounds const bounds;
+            return bounds;
+        }
+
+        [[nodiscard]] bool contains(std::uintptr_t const address)
+            const noexcept
+        {
+            return address - m_begin < m_end - m_begin;
+        }
+
+    private:
+        stack_bounds() noexcept :
+            m_begin(0),
+            m_end(0)
+        {
+#if defined(__linux__)
+            pthread_attr_t attributes;
+            if (pthread_getattr_np(pthread_self(), &attributes) == 0)
+            {
+                void * address = nullptr;
+                std::size_t size = 0;
+                if (pthread_attr_getstack(&attributes,
+                                          &address, &size) == 0)
+                {
+                    m_begin = reinterpret_cast<std::uintptr_t>(address);
+                    m_end = m_begin + size;
+                }
+                pthread_attr_destroy(&attributes);
+            }
+#endif
+        }
+
+        std::uintptr_t m_begin;
+        std::uintptr_t m_end;
+};
+
+[[nodiscard]] inline ownership classify(void const * const p) noexcept
+{
+    std::uintptr_t const address = reinterpret_cast<std::uintptr_t>(p);
+    if (stack_bounds::get().contains(address))
+    {
+        return ownership::stack;
+    }
+    return range_table::get().find(address);
+}
+
+// memory_classifier_t function
+[[nodiscard]] inline bool is_owned(void const * const p) noexcept
+{
+    ownership const type = classify(p);
+    return type == ownership::heap || type == ownership::static_data;
+}
+
+// use the address ranges for all effects::context pointer regions
+inline void install() noexcept
+{
+    static_cast<void>(range_table::get());
+    memory_classifier.store(&is_owned, std::memory_order_relaxed);
+}
+
+} // namespace memory
+
+} // namespace effects
+
+#endif // EFFECTS_MEMORY_HPP
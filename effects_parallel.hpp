@@ -0,0 +1,229 @@
+//-*-Mode:C++;coding:utf-8;tab-width:4;c-basic-offset:4;indent-tabs-mode:()-*-
+// ex: set ft=cpp fenc=utf-8 sts=4 ts=4 sw=4 et nomod:
+//
+// MIT License
+//
+// Copyright (c) 2023 Michael Truog <mjtruog at protonmail dot com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the "Software"),
+// to deal in the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+//
+
+#ifndef EFFECTS_PARALLEL_HPP
+#define EFFECTS_PARALLEL_HPP
+
+// Effect tracking for the C++17 parallel algorithms.
+// The input is split into chunks with each chunk executed serially by a
+// thread using a shared_context::shard, so the FE_* flags are captured on
+// the thread that executed the chunk when the chunk completes.
+// The effects of all chunks are merged into the context provided.
+// (with libstdc++ the parallel algorithms may require linking with -ltbb)
+
+#include "effects.hpp"
+#include <execution>
+#include <algorithm>
+#include <functional>
+#include <iterator>
+#include <optional>
+#include <thread>
+#include <vector>
+
+namespace effects
+{
+
+namespace par
+{
+
+template <typename ExecutionPolicy>
+using enable_if_execution_policy = std::enable_if_t<
+    std::is_execution_policy_v< std::decay_t<ExecutionPolicy> >
+>;
+
+// split [first, last) into non-empty chunks
+template <typename ForwardIt>
+std::vector< std::pair<ForwardIt, ForwardIt> >
+chunks(ForwardIt first, ForwardIt last)
+{
+    std::vector< std::pair<ForwardIt, ForwardIt> > result;
+    std::size_t const size = std::distance(first, last);
+    if (size == 0)
+    {
+        return result;
+    }
+    std::size_t count = std::thread::hardware_concurrency() * 4;
+    if (count == 0)
+    {
+        count = 1;
+    }
+    else if (count > size)
+    {
+        count = size;
+    }
+    std::size_t const chunk_size = size / count;
+    std::size_t chunk_size_extra = size % count;
+    result.reserve(count);
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        ForwardIt chunk_last = std::next(first, chunk_size);
+        if (chunk_size_extra > 0)
+        {
+            ++chunk_last;
+            --chunk_size_extra;
+        }
+        result.emplace_back(first, chunk_last);
+        first = chunk_last;
+    }
+    return result;
+}
+
+// execute f for each chunk with a shard of the shared_context
+// (std::execution::par is used for the chunks if the policy is
+//  std::execution::par or std::execution::par_unseq, since the
+//  shard use is vectorization-unsafe, with each chunk executed serially
+//  to allow vectorization of the chunk loop)
+template <typename ExecutionPolicy, typename Chunks, typename F>
+void for_each_chunk(context & c, Chunks & chunks, F f)
+{
+    // the FE_* flags of the caller's thread are sampled before
+    // the shards clear the FE_* flags
+    c.sample();
+    shared_context shared(c.kind_valid(), context_type::terminating);
+    auto chunk_f = [&shared, &f](auto & chunk) {
+        shared_context::shard c_chunk(shared);
+        f(c_chunk, chunk);
+    };
+    if constexpr (std::is_same_v<std::decay_t<ExecutionPolicy>,
+                                 std::execution::sequenced_policy>)
+    {
+        std::for_each(std::execution::seq,
+                      chunks.begin(), chunks.end(), chunk_f);
+    }
+    else
+    {
+        std::for_each(std::execution::par,
+                      chunks.begin(), chunks.end(), chunk_f);
+    }
+    c.merge(shared.kind());
+}
+
+// f is called as f(element) or f(context &, element)
+// with the context of the chunk provided
+template <typename F, typename T>
+decltype(auto) invoke(F & f, context & c, T && element)
+{
+    if constexpr (std::is_invocable_v<F &, context &, T>)
+    {
+        return f(c, std::forward<T>(element));
+    }
+    else
+    {
+        return f(std::forward<T>(element));
+    }
+}
+
+// std::for_each with each element treated as a reference
+// (a kind::reference effect, like region_span)
+template <typename ExecutionPolicy, typename ForwardIt,
+          typename UnaryFunction,
+          typename = enable_if_execution_policy<ExecutionPolicy> >
+void for_each(context & c, ExecutionPolicy &&,
+              ForwardIt first, ForwardIt last, UnaryFunction f)
+{
+    auto chunks_all = chunks(first, last);
+    for_each_chunk<ExecutionPolicy>(c, chunks_all,
+                                    [&f](context & c_chunk, auto & chunk) {
+        for (ForwardIt it = chunk.first; it != chunk.second; ++it)
+        {
+            invoke(f, c_chunk, *it);
+        }
+        c_chunk.merge(kind::reference);
+    });
+}
+
+// std::transform with each output element treated as a reference
+// (a kind::reference effect, like region_span)
+template <typename ExecutionPolicy, typename ForwardIt1, typename ForwardIt2,
+          typename UnaryOperation,
+          typename = enable_if_execution_policy<ExecutionPolicy> >
+ForwardIt2 transform(context & c, ExecutionPolicy &&,
+                     ForwardIt1 first, ForwardIt1 last, ForwardIt2 d_first,
+                     UnaryOperation unary_op)
+{
+    auto chunks_all = chunks(first, last);
+    std::vector<ForwardIt2> d_chunks;
+    d_chunks.reserve(chunks_all.size());
+    for (auto const & chunk : chunks_all)
+    {
+        d_chunks.emplace_back(d_first);
+        std::advance(d_first, std::distance(chunk.first, chunk.second));
+    }
+    for_each_chunk<ExecutionPolicy>(c, chunks_all,
+                                    [&unary_op, &chunks_all, &d_chunks](
+                                        context & c_chunk, auto & chunk) {
+        ForwardIt2 d_it = d_chunks[&chunk - chunks_all.data()];
+        for (ForwardIt1 it = chunk.first; it != chunk.second; ++it, ++d_it)
+        {
+            *d_it = invoke(unary_op, c_chunk, *it);
+        }
+        c_chunk.merge(kind::reference);
+    });
+    return d_first;
+}
+
+// std::reduce with the result stored in a region
+template <typename ExecutionPolicy, typename ForwardIt, typename T,
+          typename BinaryOp,
+          typename = enable_if_execution_policy<ExecutionPolicy> >
+[[nodiscard]] region<T> reduce(context & c, ExecutionPolicy &&,
+                               ForwardIt first, ForwardIt last, T init,
+                               BinaryOp binary_op)
+{
+    auto chunks_all = chunks(first, last);
+    std::vector< std::optional<T> > results(chunks_all.size());
+    for_each_chunk<ExecutionPolicy>(c, chunks_all,
+                                    [&binary_op, &chunks_all, &results](
+                                        context &, auto & chunk) {
+        ForwardIt it = chunk.first;
+        T result = *it;
+        for (++it; it != chunk.second; ++it)
+        {
+            result = binary_op(std::move(result), *it);
+        }
+        results[&chunk - chunks_all.data()] = std::move(result);
+    });
+    for (std::optional<T> & result : results)
+    {
+        init = binary_op(std::move(init), std::move(*result));
+    }
+    return c(std::move(init));
+}
+
+template <typename ExecutionPolicy, typename ForwardIt, typename T,
+          typename = enable_if_execution_policy<ExecutionPolicy> >
+[[nodiscard]] region<T> reduce(context & c, ExecutionPolicy && policy,
+                               ForwardIt first, ForwardIt last, T init)
+{
+    return reduce(c, std::forward<ExecutionPolicy>(policy),
+                  first, last, std::move(init), std::plus<>());
+}
+
+} // namespace par
+
+} // namespace effects
+
+#endif // EFFECTS_PARALLEL_HPP
@@ -0,0 +1,90 @@
+//-*-Mode:C++;coding:utf-8;tab-width:4;c-basic-offset:4;indent-tabs-mode:()-*-
+// ex: set ft=cpp fenc=utf-8 sts=4 ts=4 sw=4 et nomod:
+
+// merge and summarize effects_report.hpp files
+// (usage: effects_report file...)
+
+#include "effects_report.hpp"
+#include <algorithm>
+#include <cinttypes>
+#include <cstdio>
+#include <map>
+#include <utility>
+#include <vector>
+
+using namespace effects;
+
+int main(int argc, char ** argv)
+{
+    if (argc < 2)
+    {
+        std::fprintf(stderr, "usage: %s file...\n", argv[0]);
+        return 1;
+    }
+    std::vector<report::record> records;
+    for (int i = 1; i < argc; ++i)
+    {
+        if (! report::read(argv[i], records))
+        {
+            std::fprintf(stderr, "invalid report file: %s\n", argv[i]);
+            return 1;
+        }
+    }
+
+    // merge the records for each call site and kind
+    // (the merged count is 64-bit, since the uint32_t record counts of
+    //  many files may wrap around)
+    struct summary_type
+    {
+        report::record record;
+        std::uint64_t count;
+    };
+    std::map< std::pair<std::uint64_t, std::uint32_t>,
+              summary_type > merged;
+    std::uint64_t total = 0;
+    std::uint64_t total_fpe = 0;
+    for (report::record const & value : records)
+    {
+        auto [it, inserted] = merged.try_emplace(
+            {value.site, value.kind}, summary_type{value, value.count});
+        summary_type & summary = it->second;
+        if (! inserted)
+        {
+            summary.count += value.count;
+            summary.record.timestamp_first = std::min(
+                summary.record.timestamp_first, value.timestamp_first);
+            summary.record.timestamp_last = std::max(
+                summary.record.timestamp_last, value.timestamp_last);
+        }
+        total += value.count;
+        if (value.kind & kind::fpe)
+        {
+            total_fpe += value.count;
+        }
+    }
+    std::vector<summary_type> summaries;
+    for (auto const & entry : merged)
+    {
+        summaries.push_back(entry.second);
+    }
+    std::sort(summaries.begin(), summaries.end(),
+              [](summary_type const & a, summary_type const & b) {
+        return a.count > b.count;
+    });
+
+    std::printf("%-18s %-8s %12s %20s %20s\n",
+                "site", "kind", "count", "first", "last");
+    for (summary_type const & summary : summaries)
+    {
+        std::printf("0x%016" PRIx64 " 0x%04" PRIx32 "   %12" PRIu64
+                    " %20" PRIu64 " %20" PRIu64 "\n",
+                    summary.record.site, summary.record.kind, summary.count,
+                    summary.record.timestamp_first,
+                    summary.record.timestamp_last);
+    }
+    std::printf("%zu files, %zu records, %" PRIu64 " reports "
+                "(%" PRIu64 " with FPE)\n",
+                static_cast<std::size_t>(argc - 1), summaries.size(),
+                total, total_fpe);
+    return 0;
+}
@@ -0,0 +1,309 @@
+//-*-Mode:C++;coding:utf-8;tab-width:4;c-basic-offset:4;indent-tabs-mode:()-*-
+// ex: set ft=cpp fenc=utf-8 sts=4 ts=4 sw=4 et nomod:
+//
+// MIT License
+//
+// Copyright (c) 2023 Michael Truog <mjtruog at protonmail dot com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the "Software"),
+// to deal in the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+//
+
+
+#ifndef EFFECTS_REPORT_HPP
+#define EFFECTS_REPORT_HPP
+
+// Binary effect reports for offline analysis.
+// A report file is a file_header followed by fixed-size records
+// (in the byte order of the host that created the file).
+// Each thread appends records with a report::buffer that coalesces
+// repeated records of a call site and flushes by reserving space in the
+// memory-mapped file with an atomic increment, so writing never blocks
+// (records are dropped and counted if the file is full).
+
+#include "effects.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#define EFFECTS_REPORT_MMAP
+#endif
+
+namespace effects
+{
+
+namespace report
+{
+
+inline constexpr char magic[4] = {'E', 'F', 'F', 'R'};
+inline constexpr std::uint16_t version = 1;
+
+struct file_header
+{
+    char magic[4];
+    std::uint16_t version;
+    std::uint16_t record_size;
+    // maximum number of records
+    std::uint64_t capacity;
+};
+static_assert(sizeof(file_header) == 16);
+
+struct record
+{
+    // call-site id (e.g., from site_id)
+    std::uint64_t site;
+    // kind and kind_fpe bits
+    std::uint32_t kind;
+    // number of times the kind was reported (0 for an unused record)
+    std::uint32_t count;
+    // system_clock nanoseconds since the epoch
+    std::uint64_t timestamp_first;
+    std::uint64_t timestamp_last;
+};
+static_assert(sizeof(record) == 32);
+
+// call-site id as the FNV-1a hash of the file name and line number
+[[nodiscard]] constexpr std::uint64_t site_id(char const * file,
+                                              std::uint32_t const line)
+    noexcept
+{
+    std::uint64_t hash = 0xcbf29ce484222325ULL;
+    for (; *file != '\0'; ++file)
+    {
+        hash = (hash ^ static_cast<unsigned char>(*file)) *
+               0x100000001b3ULL;
+    }
+    for (std::size_t i = 0; i < sizeof(line); ++i)
+    {
+        hash = (hash ^ ((line >> (i * 8)) & 0xff)) * 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+#define EFFECTS_REPORT_SITE ::effects::report::site_id(__FILE__, __LINE__)
+
+[[nodiscard]] inline std::uint64_t timestamp() noexcept
+{
+    return static_cast<std::uint64_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::system_clock::now().time_since_epoch()).count());
+}
+
+// memory-mapped report file shared by all threads
+class writer
+{
+    public:
+        writer(char const * const path,
+               std::size_t const capacity) noexcept :
+            m_file(-1),
+            m_data(nullptr),
+            m_capacity(capacity),
+            m_next(0),
+            m_dropped(0)
+        {
+#if defined(EFFECTS_REPORT_MMAP)
+            std::size_t const size = sizeof(file_header) +
+                                     capacity * sizeof(record);
+            m_file = ::open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+            if (m_file == -1)
+            {
+                return;
+            }
+            if (::ftruncate(m_file, static_cast<off_t>(size)) == 0)
+            {
+                void * const data = ::mmap(nullptr, size,
+                                           PROT_READ | PROT_WRITE,
+                                           MAP_SHARED, m_file, 0);
+                if (data != MAP_FAILED)
+                {
+                    m_data = static_cast<unsigned char *>(data);
+                    file_header header = {};
+                    std::memcpy(header.magic, report::magic,
+                                sizeof(header.magic));
+                    header.version = report::version;
+                    header.record_size = sizeof(record);
+                    header.capacity = capacity;
+                    std::memcpy(m_data, &header, sizeof(header));
+                    return;
+                }
+            }
+            ::close(m_file);
+            m_file = -1;
+#else
+            static_cast<void>(path);
+#endif
+        }
+
+        writer(writer const & o) = delete;
+
+        ~writer() noexcept
+        {
+#if defined(EFFECTS_REPORT_MMAP)
+            if (m_data == nullptr)
+            {
+                return;
+            }
+            // remove the unused records
+            std::size_t const used =
+                std::min<std::size_t>(m_next.load(), m_capacity);
+            ::munmap(m_data, sizeof(file_header) +
+                             m_capacity * sizeof(record));
+            if (::ftruncate(m_file, static_cast<off_t>(
+                    sizeof(file_header) + used * sizeof(record))) != 0)
+            {
+                // the unused records are ignored by read
+            }
+            ::close(m_file);
+#endif
+        }
+
+        [[nodiscard]] bool valid() const noexcept
+        {
+            return m_data != nullptr;
+        }
+
+        [[nodiscard]] std::uint64_t dropped() const noexcept
+        {
+            // records dropped because the file was full
+            return m_dropped.load(std::memory_order_relaxed);
+        }
+
+        // append records without blocking
+        bool append(record const * const records,
+                    std::size_t const count) noexcept
+        {
+            if (m_data == nullptr || count == 0)
+            {
+                return count == 0;
+            }
+            std::size_t const index =
+                m_next.fetch_add(count, std::memory_order_relaxed);
+            if (index >= m_capacity || count > m_capacity - index)
+            {
+                m_dropped.fetch_add(count, std::memory_order_relaxed);
+                return false;
+            }
+            std::memcpy(m_data + sizeof(file_header) +
+                        index * sizeof(record),
+                        records, count * sizeof(record));
+            return true;
+        }
+
+    private:
+        int m_file;
+        unsigned char * m_data;
+        std::size_t const m_capacity;
+        std::atomic<std::size_t> m_next;
+        std::atomic<std::uint64_t> m_dropped;
+};
+
+// buffer of records for a single thread
+class buffer
+{
+    public:
+        static constexpr std::size_t size = 64;
+
+        explicit buffer(writer & w) noexcept :
+            m_writer(w),
+            m_count(0)
+        {
+        }
+
+        buffer(buffer const & o) = delete;
+
+        ~buffer() noexcept
+        {
+            flush();
+        }
+
+        void add(std::uint64_t const site, unsigned int const kind) noexcept
+        {
+            std::uint64_t const now = report::timestamp();
+            if (m_count > 0)
+            {
+                // coalesce repeated records of a call site
+                record & last = m_records[m_count - 1];
+                if (last.site == site && last.kind == kind &&
+                    last.count < UINT32_MAX)
+                {
+                    ++last.count;
+                    last.timestamp_last = now;
+                    return;
+                }
+                if (m_count == size)
+                {
+                    flush();
+                }
+            }
+            m_records[m_count++] = {site, kind, 1, now, now};
+        }
+
+        void add(std::uint64_t const site, context & c) noexcept
+        {
+            add(site, c.kind());
+        }
+
+        void flush() noexcept
+        {
+            m_writer.append(m_records, m_count);
+            m_count = 0;
+        }
+
+    private:
+        writer & m_writer;
+        std::size_t m_count;
+        record m_records[size];
+};
+
+// append the used records of a report file
+[[nodiscard]] inline bool read(char const * const path,
+                               std::vector<record> & records)
+{
+    std::FILE * const file = std::fopen(path, "rb");
+    if (file == nullptr)
+    {
+        return false;
+    }
+    file_header header;
+    bool result = std::fread(&header, sizeof(header), 1, file) == 1 &&
+                  std::memcmp(header.magic, report::magic,
+                              sizeof(header.magic)) == 0 &&
+                  header.version == report::version &&
+                  header.record_size == sizeof(record);
+    record value;
+    while (result && std::fread(&value, sizeof(value), 1, file) == 1)
+    {
+        if (value.count > 0)
+        {
+            records.push_back(value);
+        }
+    }
+    std::fclose(file);
+    return result;
+}
+
+} // namespace report
+
+} // namespace effects
+
+#endif // EFFECTS_REPORT_HPP
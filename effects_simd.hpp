@@ -0,0 +1,105 @@
+//-*-Mode:C++;coding:utf-8;tab-width:4;c-basic-offset:4;indent-tabs-mode:()-*-
+// ex: set ft=cpp fenc=utf-8 sts=4 ts=4 sw=4 et nomod:
+//
+// MIT License
+//
+// Copyright (c) 2023 Michael Truog <mjtruog at protonmail dot com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the "Software"),
+// to deal in the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+//
+
+#ifndef EFFECTS_SIMD_HPP
+#define EFFECTS_SIMD_HPP
+
+// SIMD vector types tracked as floating-point packs.
+// The FE_* flags are sticky and set by any lane of a SIMD operation,
+// so a single read of the FE_* flags captures the
+// Floating-Point Exceptions (FPE) of all lanes
+// (the SIMD computation is not scalarized).
+
+#include "effects.hpp"
+#if defined(__SSE__) || defined(__AVX__)
+#include <immintrin.h>
+#endif
+#if defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+#if __has_include(<experimental/simd>)
+#include <experimental/simd>
+#endif
+
+#if defined(__GNUC__)
+#pragma GCC diagnostic push
+// the vector type attributes are not part of the template argument
+#pragma GCC diagnostic ignored "-Wignored-attributes"
+#endif
+
+namespace effects
+{
+
+#if defined(__SSE__)
+template <>
+struct is_floating_point_pack<__m128> : std::true_type
+{};
+#endif
+#if defined(__SSE2__)
+template <>
+struct is_floating_point_pack<__m128d> : std::true_type
+{};
+#endif
+#if defined(__AVX__)
+template <>
+struct is_floating_point_pack<__m256> : std::true_type
+{};
+template <>
+struct is_floating_point_pack<__m256d> : std::true_type
+{};
+#endif
+#if defined(__AVX512F__)
+template <>
+struct is_floating_point_pack<__m512> : std::true_type
+{};
+template <>
+struct is_floating_point_pack<__m512d> : std::true_type
+{};
+#endif
+#if defined(__ARM_NEON)
+template <>
+struct is_floating_point_pack<float32x4_t> : std::true_type
+{};
+#if defined(__aarch64__)
+template <>
+struct is_floating_point_pack<float64x2_t> : std::true_type
+{};
+#endif
+#endif
+#if __has_include(<experimental/simd>)
+template <typename T, typename Abi>
+struct is_floating_point_pack< std::experimental::simd<T, Abi> > :
+    std::is_floating_point<T>
+{};
+#endif
+
+} // namespace effects
+
+#if defined(__GNUC__)
+#pragma GCC diagnostic pop
+#endif
+
+#endif // EFFECTS_SIMD_HPP
@@ -0,0 +1,279 @@
+//-*-Mode:C++;coding:utf-8;tab-width:4;c-basic-offset:4;indent-tabs-mode:()-*-
+// ex: set ft=cpp fenc=utf-8 sts=4 ts=4 sw=4 et nomod:
+//
+// MIT License
+//
+// Copyright (c) 2023 Michael Truog <mjtruog at protonmail dot com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the "Software"),
+// to deal in the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+//
+
+
+#ifndef EFFECTS_TRAP_HPP
+#define EFFECTS_TRAP_HPP
+
+// Hardware trapping of Floating-Point Exceptions (FPE).
+// An fpe_trap unmasks the FPE that are not valid for a context, so the
+// first invalid FPE raises SIGFPE (instead of polling the FE_* flags)
+// and the signal handler records the FPE in the context.
+// The handler masks all FPE before the faulting instruction is restarted,
+// so only the first invalid FPE traps (the context is already invalid)
+// and the FE_* flags are still set for the next sample of the context.
+// Use fpe_sampling::deferred to avoid polling the FE_* flags for each
+// floating-point region.
+// (trapping is only enabled on x86_64 Linux and with MSVC)
+
+#include "effects.hpp"
+#include <csignal>
+#if defined(__linux__) && defined(__x86_64__)
+#include <ucontext.h>
+#define EFFECTS_TRAP_ENABLED
+#define EFFECTS_TRAP_GLIBC
+#elif defined(_MSC_VER)
+#include <float.h>
+#define EFFECTS_TRAP_ENABLED
+#define EFFECTS_TRAP_MSVC
+#endif
+
+namespace effects
+{
+
+// scope with FPE traps for a context
+class fpe_trap
+{
+    public:
+        explicit fpe_trap(context & c) noexcept :
+            m_context(c),
+            m_previous(m_current),
+            m_traps(0),
+            m_excepts(0)
+        {
+            // the FE_* flags set before the traps were enabled are sampled
+            m_context.sample();
+            m_current = &m_context;
+#if defined(EFFECTS_TRAP_ENABLED)
+            // the kind_fpe bits that are not valid (ignored FPE are valid)
+            unsigned int const kind_fpe_invalid =
+                (~m_context.kind_valid()) & kind_fpe::bitmask;
+            if (kind_fpe_invalid != kind_fpe::none && fpe_trap::install())
+            {
+#if defined(EFFECTS_TRAP_GLIBC)
+                m_excepts = fegetexcept();
+                m_traps = fpe_flags(kind_fpe_invalid);
+                feenableexcept(m_traps);
+#elif defined(EFFECTS_TRAP_MSVC)
+                unsigned int control;
+                _controlfp_s(&control, 0, 0);
+                m_excepts = control & _MCW_EM;
+                m_traps =
+                    (kind_fpe_invalid & kind_fpe::invalid ? _EM_INVALID : 0) |
+                    (kind_fpe_invalid & kind_fpe::divide_by_zero ?
+                     _EM_ZERODIVIDE : 0) |
+                    (kind_fpe_invalid & kind_fpe::overflow ?
+                     _EM_OVERFLOW : 0) |
+                    (kind_fpe_invalid & kind_fpe::underflow ?
+                     _EM_UNDERFLOW : 0) |
+                    (kind_fpe_invalid & kind_fpe::inexact ? _EM_INEXACT : 0);
+                _controlfp_s(&control, m_excepts & ~m_traps, _MCW_EM);
+#endif
+            }
+#endif
+        }
+
+        fpe_trap(fpe_trap const & o) = delete;
+
+        ~fpe_trap() noexcept
+        {
+            // restore the previous FPE masks
+#if defined(EFFECTS_TRAP_GLIBC)
+            if (m_traps != 0)
+            {
+                fedisableexcept(fpe_all);
+                feenableexcept(m_excepts);
+            }
+#elif defined(EFFECTS_TRAP_MSVC)
+            if (m_traps != 0)
+            {
+                unsigned int control;
+                _controlfp_s(&control, m_excepts, _MCW_EM);
+            }
+#endif
+            m_current = m_previous;
+        }
+
+        [[nodiscard]] bool enabled() const noexcept
+        {
+            // false if no FPE are invalid or trapping is not supported
+            return m_traps != 0;
+        }
+
+        [[nodiscard]] static context * get() noexcept
+        {
+            // the context receiving FPE traps in the current thread
+            return m_current;
+        }
+
+    private:
+        static constexpr int fpe_all = FE_INVALID | FE_DIVBYZERO |
+                                       FE_OVERFLOW | FE_UNDERFLOW |
+                                       FE_INEXACT;
+
+#if defined(EFFECTS_TRAP_GLIBC)
+        static bool install() noexcept
+        {
+            // the process-wide handler is installed once
+            static bool const installed = []() {
+                struct sigaction action = {};
+                action.sa_sigaction = fpe_trap::handler;
+                action.sa_flags = SA_SIGINFO;
+                sigemptyset(&action.sa_mask);
+                return sigaction(SIGFPE, &action, &m_handler_previous) == 0;
+            }();
+            return installed;
+        }
+
+        static void handler(int signal, siginfo_t * info, void * ucontext)
+        {
+            unsigned int kind = kind::fpe;
+            switch (info->si_code)
+            {
+                case FPE_FLTINV:
+                    kind |= kind_fpe::invalid;
+                    break;
+                case FPE_FLTDIV:
+                    kind |= kind_fpe::divide_by_zero;
+                    break;
+                case FPE_FLTOVF:
+                    kind |= kind_fpe::overflow;
+                    break;
+                case FPE_FLTUND:
+                    kind |= kind_fpe::underflow;
+                    break;
+                case FPE_FLTRES:
+                    kind |= kind_fpe::inexact;
+                    break;
+                default:
+                    // not a floating-point trap (e.g., integer division
+                    // by zero), so the signal goes to the previous handler
+                    fpe_trap::chain(signal, info, ucontext);
+                    return;
+            }
+            if (m_current != nullptr)
+            {
+                m_current->merge(kind);
+            }
+            // mask all FPE (SSE and x87) when the context is restored
+            mcontext_t & machine = static_cast<ucontext_t *>(ucontext)->
+                uc_mcontext;
+            machine.fpregs->mxcsr |= 0x1f80;
+            machine.fpregs->cwd |= 0x003f;
+            // clear the x87 exception summary and busy bits
+            machine.fpregs->swd &= ~0x8080;
+        }
+
+        static void chain(int signal, siginfo_t * info, void * ucontext)
+        {
+            // the previous handler is called without reinstalling it,
+            // so the next FPE trap still reaches fpe_trap::handler
+            struct sigaction const & previous = m_handler_previous;
+            if ((previous.sa_flags & SA_SIGINFO) != 0)
+            {
+                if (previous.sa_sigaction != nullptr)
+                {
+                    previous.sa_sigaction(signal, info, ucontext);
+                }
+            }
+            else if (previous.sa_handler == SIG_DFL)
+            {
+                // the default action for this delivery only: the signal
+                // is blocked in the handler, so it is delivered (and
+                // terminates the process) when the handler returns
+                struct sigaction action = {};
+                action.sa_handler = SIG_DFL;
+                sigemptyset(&action.sa_mask);
+                sigaction(signal, &action, nullptr);
+                raise(signal);
+            }
+            else if (previous.sa_handler != SIG_IGN)
+            {
+                previous.sa_handler(signal);
+            }
+        }
+
+        static inline struct sigaction m_handler_previous = {};
+#elif defined(EFFECTS_TRAP_MSVC)
+        static bool install() noexcept
+        {
+            static bool const installed = []() {
+                return std::signal(SIGFPE, reinterpret_cast<void (*)(int)>(
+                    fpe_trap::handler)) != SIG_ERR;
+            }();
+            return installed;
+        }
+
+        static void handler(int, int subcode)
+        {
+            unsigned int kind = kind::fpe;
+            switch (subcode)
+            {
+                case _FPE_INVALID:
+                    kind |= kind_fpe::invalid;
+                    break;
+                case _FPE_ZERODIVIDE:
+                    kind |= kind_fpe::divide_by_zero;
+                    break;
+                case _FPE_OVERFLOW:
+                    kind |= kind_fpe::overflow;
+                    break;
+                case _FPE_UNDERFLOW:
+                    kind |= kind_fpe::underflow;
+                    break;
+                case _FPE_INEXACT:
+                    kind |= kind_fpe::inexact;
+                    break;
+            }
+            if (m_current != nullptr)
+            {
+                m_current->merge(kind);
+            }
+            // mask all FPE, with the handler installed again
+            _fpreset();
+            unsigned int control;
+            _controlfp_s(&control, _MCW_EM, _MCW_EM);
+            std::signal(SIGFPE, reinterpret_cast<void (*)(int)>(
+                fpe_trap::handler));
+        }
+#endif
+
+        context & m_context;
+        context * const m_previous;
+        unsigned int m_traps;
+        unsigned int m_excepts;
+        // a plain TLS pointer (constant-initialized, without a TLS
+        // wrapper call in the handler), set before the traps are unmasked
+#if defined(EFFECTS_TRAP_GLIBC)
+        static inline __thread context * m_current = nullptr;
+#else
+        static inline thread_local context * m_current = nullptr;
+#endif
+};
+
+} // namespace effects
+
+#endif // EFFECTS_TRAP_HPP
@@ -1,13 +1,68 @@
 #include "effects.hpp"
+#include "effects_simd.hpp"
+#include "effects_parallel.hpp"
+#include "effects_memory.hpp"
+#include "effects_environment.hpp"
+#include "effects_trap.hpp"
+#include "effects_memoize.hpp"
+#include "effects_container.hpp"
+#define EFFECTS_EXCEPTION_INTERPOSE
+#include "effects_exception.hpp"
+#include "effects_report.hpp"
+#if defined(CXX20) && __has_include(<coroutine>)
+#include "effects_coroutine.hpp"
+#define TESTS_COROUTINES
+#endif
 #include <limits>
+#include <stdexcept>
+#include <vector>
+#include <tuple>
+#include <thread>
 #include <iostream>
 #include <cmath>
 #include <cassert>
+#include <cstring>
 
 namespace
 {
     int i = 1;
     int const j = 2;
+
+    // count copies and moves of a payload
+    struct instrumented
+    {
+        static inline int copies = 0;
+        static inline int moves = 0;
+
+        instrumented(int const v = 0) :
+            value(v)
+        {
+        }
+        instrumented(instrumented const & o) :
+            value(o.value)
+        {
+            ++copies;
+        }
+        instrumented(instrumented && o) noexcept :
+            value(o.value)
+        {
+            ++moves;
+        }
+        instrumented & operator = (instrumented const & o)
+        {
+            value = o.value;
+            ++copies;
+            return *this;
+        }
+        instrumented & operator = (instrumented && o) noexcept
+        {
+            value = o.value;
+            ++moves;
+            return *this;
+        }
+
+        int value;
+    };
 }
 
 using namespace effects;
@@ -39,28 +94,16 @@ void test_integers()
 void test_fpe()
 {
     context c(kind::reference | kind::fpe, context_type::terminating);
-    region<double> value_rounded = c(2.0 / 3);
-#if defined(__clang__)
+    // opaque prevents constant folding (g++ folds 2.0 / 3 without
+    // the inexact floating-point exception)
+    region<double> value_rounded = c(opaque(2.0) / 3);
     assert(c.kind() == 0x2014);
     assert(c.kind() ==
            (kind_fpe::inexact | kind::fpe | kind::reference));
-#elif defined(__GNUC__)
-    // g++ does not provide the inexact floating-point exception in this
-    // situation, probably because it is seen as a performance problem
-    // when the inexact exception is used for any round that occurs,
-    // though there doesn't appear to be a way to enable it either with
-    // a cross-platform gcc command-line flag.
-    // https://gcc.gnu.org/c99status.html
-    // says "required exceptions may not be generated"
-    assert(c.kind() == 0x0004);
-    assert(c.kind() == kind::reference);
-#else
-#error "unknown compiler!"
-#endif
     assert(c.has_reference());
     assert(c.valid());
     c.clear();
-    region<double> value_invalid = c(0.0 / 0.0);
+    region<double> value_invalid = c(opaque(0.0) / 0.0);
     assert(c.kind() == 0x0114);
     assert(c.kind() ==
            (kind_fpe::invalid | kind::fpe | kind::reference));
@@ -68,7 +111,7 @@ void test_fpe()
     assert(c.kind() == 0x0114);
     assert(c.valid());
     c.clear();
-    region<double> value_divide_by_zero = c(1.0 / 0.0);
+    region<double> value_divide_by_zero = c(opaque(1.0) / 0.0);
     assert(c.kind() == 0x0414);
     assert(c.kind() ==
            (kind_fpe::divide_by_zero | kind::fpe | kind::reference));
@@ -77,7 +120,7 @@ void test_fpe()
     assert(c.valid());
     c.clear();
     region<double> value_overflow =
-        c(std::numeric_limits<double>::max() * 2.0);
+        c(opaque(std::numeric_limits<double>::max()) * 2.0);
     assert(c.kind() == 0x2814);
     assert(c.kind() ==
            (kind_fpe::overflow | kind_fpe::inexact |
@@ -86,7 +129,7 @@ void test_fpe()
     assert(c.kind() == 0x2814);
     c.clear();
     region<double> value_underflow =
-        c(std::numeric_limits<double>::min() / 3.0);
+        c(opaque(std::numeric_limits<double>::min()) / 3.0);
     assert(c.kind() == 0x3014);
     assert(c.kind() ==
            (kind_fpe::underflow | kind_fpe::inexact |
@@ -95,7 +138,7 @@ void test_fpe()
     assert(c.kind() == 0x3014);
     assert(c.valid());
     c.clear();
-    region<double> value_inexact = c(std::sqrt(2));
+    region<double> value_inexact = c(std::sqrt(opaque(2.0)));
     assert(c.kind() == 0x2014);
     assert(! c.is_pure());
     assert(c.kind() ==
@@ -105,30 +148,156 @@ void test_fpe()
     assert(c.has_fpe(fpe_inexact));
     assert(fpe_inexact & kind_fpe::inexact);
     assert((fpe_inexact & (~kind_fpe::inexact & kind_fpe::bitmask)) == 0);
+    // the kind bits of an eager context are read without sampling
+    context const & c_const = c;
+    assert(c_const.kind() == 0x2014);
+    c.clear();
+    assert(c_const.kind() == kind::pure);
+}
+
+void test_fpe_deferred()
+{
+    context c(kind::reference | kind::fpe, context_type::terminating,
+              fpe_sampling::deferred);
+    region<double> value_invalid = c(opaque(0.0) / 0.0);
+    region<double> value_divide_by_zero = c(opaque(1.0) / 0.0);
+    // the FE_* flags are only read when the context is checked
+    assert(c.kind() == 0x0514);
+    assert(c.kind() ==
+           (kind_fpe::invalid | kind_fpe::divide_by_zero |
+            kind::fpe | kind::reference));
+    assert(c.valid());
+    c.clear();
+    region<int> value = c(1);
+    assert(c.is_pure());
+    region<double> value_overflow =
+        c(opaque(std::numeric_limits<double>::max()) * 2.0);
+    c.sample();
+    assert(c.kind() == 0x2814);
+    assert(c.kind() ==
+           (kind_fpe::overflow | kind_fpe::inexact |
+            kind::fpe | kind::reference));
+    assert(c.has_fpe());
     c.clear();
+    context c_invalid(kind::reference, context_type::terminating,
+                      fpe_sampling::deferred);
+    region<double> value_underflow =
+        c_invalid(opaque(std::numeric_limits<double>::min()) / 3.0);
+    // a const deferred context has the FE_* flags of the last sample
+    context const & c_invalid_const = c_invalid;
+    assert(c_invalid_const.kind() == kind::reference);
+    assert(! c_invalid.valid());
+    assert(c_invalid.kind() == 0x3014);
+    assert(c_invalid_const.kind() == 0x3014);
+}
+
+void test_fpe_policy()
+{
+    volatile double zero = 0.0;
+    volatile double three = 3.0;
+    // only the inexact FPE is valid
+    context c(kind::reference | kind_fpe::inexact, context_type::terminating);
+    assert(c.kind_valid() == (kind::reference | kind::fpe |
+                              kind_fpe::inexact));
+    region<double> value1 = c(1.0 / three);
+    assert(c.kind() == (kind_fpe::inexact | kind::fpe | kind::reference));
+    assert(c.valid());
+    region<double> value2 = c(1.0 / zero);
+    assert(c.kind() == (kind_fpe::inexact | kind_fpe::divide_by_zero |
+                        kind::fpe | kind::reference));
+    assert(! c.valid());
+    // the inexact FPE is ignored (not tested or cleared)
+    context c_ignored(kind::reference, context_type::terminating,
+                      fpe_sampling::eager, kind_fpe::inexact);
+    region<double> value3 = c_ignored(1.0 / three);
+    assert(c_ignored.kind() == kind::reference);
+    assert(std::fetestexcept(FE_INEXACT));
+    assert(c_ignored.valid());
+    {
+        // a child context ignores the same FPE
+        child_context c_child = c_ignored.child(kind::reference);
+        region<double> value4 = c_child(2.0 / three);
+        assert(c_child.valid());
+    }
+    region<double> value5 =
+        c_ignored(opaque(std::numeric_limits<double>::max()) * three);
+    assert(c_ignored.kind() == (kind_fpe::overflow |
+                                kind::fpe | kind::reference));
+    assert(! c_ignored.valid());
+    std::feclearexcept(FE_ALL_EXCEPT);
+}
+
+#if defined(EFFECTS_TRAP_GLIBC)
+volatile std::sig_atomic_t fpe_trap_chained = 0;
+
+void fpe_trap_previous(int)
+{
+    fpe_trap_chained = fpe_trap_chained + 1;
+}
+#endif
+
+void test_fpe_trap()
+{
+#if defined(EFFECTS_TRAP_GLIBC)
+    // the handler installed before the first fpe_trap
+    std::signal(SIGFPE, fpe_trap_previous);
+#endif
+    context c(kind::reference, context_type::terminating,
+              fpe_sampling::deferred);
+    {
+        fpe_trap trap(c);
+        assert(fpe_trap::get() == &c);
+#if defined(EFFECTS_TRAP_ENABLED)
+        assert(trap.enabled());
+#endif
+        volatile double zero = 0.0;
+        region<double> value = c(1.0 / zero);
+        if (trap.enabled())
+        {
+            // recorded by the trap without the FE_* flags
+            std::feclearexcept(FE_ALL_EXCEPT);
+        }
+        assert(c.kind() == 0x0414);
+        assert(c.kind() == (kind_fpe::divide_by_zero |
+                            kind::fpe | kind::reference));
+        assert(! c.valid());
+    }
+    // the previous FPE masks are restored
+    assert(fpe_trap::get() == nullptr);
+#if defined(EFFECTS_TRAP_GLIBC)
+    assert(fegetexcept() == 0);
+#endif
+    context c_valid(kind::reference | kind::fpe, context_type::terminating);
+    fpe_trap trap_valid(c_valid);
+    assert(! trap_valid.enabled());
+#if defined(EFFECTS_TRAP_GLIBC)
+    // a SIGFPE that is not a floating-point trap is chained to the
+    // previous handler, and the FPE traps are still handled
+    std::raise(SIGFPE);
+    assert(fpe_trap_chained == 1);
+    {
+        context c_chained(kind::reference, context_type::terminating,
+                          fpe_sampling::deferred);
+        fpe_trap trap(c_chained);
+        volatile double zero = 0.0;
+        region<double> value = c_chained(1.0 / zero);
+        std::feclearexcept(FE_ALL_EXCEPT);
+        assert(c_chained.kind() == (kind_fpe::divide_by_zero |
+                                    kind::fpe | kind::reference));
+    }
+    std::raise(SIGFPE);
+    assert(fpe_trap_chained == 2);
+#endif
 }
 
 void test_pointers()
 {
-#if defined(__clang__)
     context c(kind::fpe |
               kind::reference | kind::write, context_type::terminating);
-#elif defined(__GNUC__)
-    context c(kind::reference | kind::write, context_type::terminating);
-#else
-#error "unknown compiler!"
-#endif
-    region<double *> p1_value = c(new double(2.0 / 3));
-#if defined(__clang__)
+    region<double *> p1_value = c(new double(opaque(2.0) / 3));
     assert(c.kind() == 0x201c);
     assert(c.kind() ==
            (kind_fpe::inexact | kind::fpe | kind::reference | kind::write));
-#elif defined(__GNUC__)
-    assert(c.kind() == 0x000c);
-    assert(c.kind() == (kind::reference | kind::write));
-#else
-#error "unknown compiler!"
-#endif
     assert(c.valid());
     delete p1_value;
     p1_value = 0;
@@ -155,11 +324,1121 @@ void test_pointers()
     assert(c.valid());
 }
 
+void test_memory()
+{
+    memory::install();
+    context c(kind::pure, context_type::terminating);
+    // read-only data and stack memory are not owned global data
+    region<char const *> p1_value =
+        c(static_cast<char const *>("valid without a write effect"));
+    assert(memory::classify(p1_value) == memory::ownership::read_only);
+    int local = 1;
+    region<int *> p2_value = c(&local);
+    assert(memory::classify(p2_value) == memory::ownership::stack);
+    assert(c.is_pure());
+    assert(c.valid());
+    region<int *> p3_value = c(&i);
+    assert(memory::classify(p3_value) == memory::ownership::static_data);
+    assert(c.kind() == kind::write);
+    c.clear();
+    region<int *> p4_value = c(new int(4));
+    assert(memory::classify(p4_value) == memory::ownership::heap);
+    assert(c.kind() == kind::write);
+    delete p4_value;
+    // the thread stack bounds are separate for each thread
+    std::thread([&local]() {
+        assert(memory::classify(&local) != memory::ownership::stack);
+        int local_thread = 2;
+        assert(memory::classify(&local_thread) == memory::ownership::stack);
+    }).join();
+    memory_classifier.store(nullptr);
+}
+
+// effects verified during constant evaluation
+constexpr int constant_square(int const x)
+{
+    context c(kind::pure, context_type::terminating);
+    region<int> value = c(x * x);
+    value = value + 1;
+    return c.valid() ? static_cast<int>(value) - 1 : -1;
+}
+static_assert(constant_square(3) == 9);
+
+constexpr unsigned int constant_kind()
+{
+    context c(kind::reference, context_type::terminating);
+    int local = 1;
+    region<double> value_double = c(1.0 / 3.0);
+    region<int *> p_value = c(&local);
+    region<int *> p_null = c(static_cast<int *>(nullptr));
+    c.set_exception();
+    return c.kind();
+}
+static_assert(constant_kind() ==
+              (kind::exception | kind::reference | kind::write));
+
+void test_environment()
+{
+    environment::features const & features = environment::probe();
+    assert(&features == &environment::probe());
+    assert(features.long_bits == sizeof(long) * CHAR_BIT);
+#if ! defined(_WIN32)
+    assert(features.path_separator == '/');
+#endif
+    // the default floating-point environment
+    assert(! features.flush_to_zero && ! features.denormals_are_zero);
+    assert(features.kind_floating_point == kind::pure);
+    context c(kind::reference, context_type::terminating);
+    // type-derived variation effects
+    region<wchar_t> value_wchar = c(L'a');
+    assert(c.kind() == kind::variation_os);
+    c.clear();
+    region<long double> value_long_double = c(opaque(1.0L));
+    assert(c.kind() == (kind::variation_hardware | kind::reference));
+    c.clear();
+    region<int> value_int = c(1);
+    region<long long> value_long_long = c(1LL);
+    assert(c.is_pure());
+    // std::size_t is not a variation effect (though it is long with LP64)
+    std::vector<int> const values(3);
+    context c_pure(kind::pure, context_type::terminating);
+    region<std::size_t> size = c_pure(values.size());
+    region<std::int64_t> value_int64 = c_pure(std::int64_t{1});
+    assert(c_pure.is_pure());
+    assert(c_pure.valid());
+    static_context<kind::pure> c_static;
+    region<std::size_t, static_context<kind::pure>> size_static =
+        c_static(values.size());
+    assert(c_static.valid());
+    environment::install();
+    region<double> value1 = c(opaque(1.0) * 2.0);
+    assert(c.kind() == kind::reference);
+    c.clear();
+    // as if FTZ/DAZ were enabled when probed
+    floating_point_variation.store(kind::variation_hardware);
+    region<double> value2 = c(opaque(1.0) * 2.0);
+    region<int> value3 = c(1);
+    assert(c.kind() == (kind::variation_hardware | kind::reference));
+    floating_point_variation.store(kind::pure);
+}
+
+void test_move()
+{
+    context c(kind::pure, context_type::terminating);
+    region<instrumented> value = c.make<instrumented>(1);
+    assert(instrumented::copies == 0);
+    assert(instrumented::moves == 0);
+    // any number of constructor arguments
+    region< std::tuple<int, int, int, int> > values =
+        c.make< std::tuple<int, int, int, int> >(1, 2, 3, 4);
+    assert(std::get<3>(static_cast<std::tuple<int, int, int, int> const &>(
+        values)) == 4);
+    value = instrumented(2);
+    assert(instrumented::copies == 0);
+    assert(instrumented::moves == 1);
+    region<instrumented> value_other = c(instrumented(3));
+    assert(instrumented::copies == 0);
+    assert(instrumented::moves == 2);
+    value = std::move(value_other);
+    assert(instrumented::copies == 0);
+    assert(instrumented::moves == 3);
+    instrumented const copied(4);
+    value = copied;
+    assert(instrumented::copies == 1);
+    assert(instrumented::moves == 3);
+    instrumented taken = value.take();
+    assert(taken.value == 4);
+    assert(instrumented::copies == 1);
+    assert(instrumented::moves == 4);
+    instrumented referenced(5);
+    region<instrumented &> value_reference = c(referenced);
+    value_reference = instrumented(6);
+    assert(referenced.value == 6);
+    assert(instrumented::copies == 1);
+    assert(instrumented::moves == 5);
+    assert(c.kind() == kind::reference);
+    assert(! c.valid());
+}
+
+double callee(context & c, double const x)
+{
+    child_context c_callee = c.child(kind::reference);
+    region<double> value = c_callee(1.0 / x);
+    // the divide_by_zero is not valid in the callee
+    assert(! c_callee.valid());
+    return value;
+}
+
+void test_child_context()
+{
+    context c(kind::reference | kind::fpe, context_type::terminating);
+    // FE_* flags set without being sampled by a region
+    volatile double value_invalid = opaque(0.0) / 0.0;
+    {
+        child_context c_child = c.child(kind::pure);
+        assert(c.kind() == 0x0110);
+        assert(c.kind() == (kind_fpe::invalid | kind::fpe));
+        region<int> value = c_child(1);
+        assert(c_child.is_pure());
+        assert(c_child.valid());
+    }
+    assert(c.kind() == (kind_fpe::invalid | kind::fpe));
+    region<double> value = c(callee(c, 0.0));
+    assert(c.kind() == 0x0514);
+    assert(c.kind() ==
+           (kind_fpe::invalid | kind_fpe::divide_by_zero |
+            kind::fpe | kind::reference));
+    assert(c.valid());
+    c.clear();
+    child_context c_child = c.child(kind::reference,
+                                    context_type::nonterminating);
+    assert(c_child.has_nonterminating());
+    c_child.join();
+    assert(c.kind() == kind::nonterminating);
+    assert(! c.valid());
+    static_cast<void>(value_invalid);
+}
+
+void test_arena()
+{
+    context c(kind::reference, context_type::terminating);
+    // no arena, so no allocation
+    region<int *> p0_value = c.alloc<int>(1);
+    assert(p0_value == nullptr);
+    alignas(double) unsigned char buffer[3 * sizeof(double)];
+    {
+        arena a(c, buffer, sizeof(buffer));
+        region<double *> p1_value = c.alloc<double>(1.5);
+        region<int *> p2_value = c.alloc<int>(2);
+        assert(*p1_value == 1.5 && *p2_value == 2);
+        assert(a.contains(p1_value) && a.contains(p2_value));
+        // arena memory is owned by the context
+        // (floating-point use remains a reference effect)
+        assert(c.kind() == kind::reference);
+        assert(c.valid());
+        region<std::int64_t *> p3_value = c.alloc<std::int64_t>(3);
+        region<std::int64_t *> p4_value = c.alloc<std::int64_t>(4);
+        assert(p3_value != nullptr && p4_value == nullptr);
+        assert(a.used() == a.size());
+        // clear releases all arena allocations
+        c.clear();
+        assert(a.used() == 0);
+        region<int *> p5_value = c.alloc<int>(5);
+        assert(static_cast<void *>(p5_value) == buffer);
+        {
+            // the child context allocates in the parent's arena
+            child_context c_child = c.child(kind::reference);
+            region<int *> p_child = c_child.alloc<int>(8);
+            assert(a.contains(p_child));
+            std::size_t const used = a.used();
+            c_child.clear();
+            assert(a.used() == used);
+        }
+#if defined(EFFECTS_PMR)
+        std::pmr::vector<int> v({1, 2}, &a);
+        assert(a.contains(v.data()));
+#endif
+        // heap memory is still a write effect
+        region<int *> p6_value = c(new int(6));
+        assert(c.kind() == kind::write);
+        assert(! c.valid());
+        delete p6_value;
+    }
+    assert(c.alloc<int>(7) == nullptr);
+}
+
+void test_region_vector()
+{
+    context c(kind::reference | kind::write | kind::exception | kind::fpe,
+              context_type::terminating);
+    region_vector<int> values(c);
+    assert(c.is_pure());
+    values.reserve(4);
+    assert(c.kind() == (kind::exception | kind::write));
+    c.clear();
+    // no allocation (or exception) after reserve
+    for (int value = 0; value < 4; ++value)
+    {
+        values.push_back(value);
+    }
+    assert(c.is_pure());
+    assert(values.size() == 4 && values[3] == 3);
+    values.push_back(4);
+    assert(c.kind() == (kind::exception | kind::write));
+    c.clear();
+    // in-place modification
+    values.modify(0, [](int & value) noexcept { value = 10; });
+    values.transform([](int const value) noexcept { return value * 2; });
+    assert(values[0] == 20 && values[4] == 8);
+    assert(c.is_pure());
+    // a callable that may throw
+    values.modify(1, [](int & value) { value += 0; });
+    assert(c.kind() == kind::exception);
+    c.clear();
+    values.transform([](int const value) { return value; });
+    assert(c.kind() == kind::exception);
+    c.clear();
+    region_vector<double> values_double(c, std::vector<double>{1.0, 2.0});
+    assert(c.kind() == (kind::reference | kind::write));
+    c.clear();
+    values_double.transform([](double const x) noexcept {
+        return x / opaque(0.0);
+    });
+    assert(c.kind() == (kind_fpe::divide_by_zero |
+                        kind::fpe | kind::reference));
+    assert(c.valid());
+    c.clear();
+    std::vector<int> const released = std::move(values).release();
+    assert(released.size() == 5 && released[0] == 20);
+#if defined(EFFECTS_PMR)
+    alignas(double) unsigned char buffer[4 * sizeof(double)];
+    arena a(c, buffer, sizeof(buffer));
+    region_vector< double, std::pmr::polymorphic_allocator<double> >
+        values_arena(c, &a);
+    // arena storage is owned by the context
+    values_arena.reserve(4);
+    assert(a.contains(values_arena.data()));
+    assert(c.kind() == kind::exception);
+    values_arena.push_back(1.0);
+    assert(c.kind() == (kind::exception | kind::reference));
+#endif
+}
+
+void test_region_map()
+{
+    context c(kind::reference | kind::write | kind::exception | kind::fpe,
+              context_type::terminating);
+    region_map<int, double> values(c);
+    assert(c.is_pure());
+    values.emplace(1, 2.0);
+    assert(c.kind() == (kind::exception | kind::write | kind::reference));
+    c.clear();
+    // in-place modification
+    assert(values.modify(1, [](double & value) noexcept {
+        value /= opaque(0.0);
+    }));
+    assert(c.kind() == (kind_fpe::divide_by_zero |
+                        kind::fpe | kind::reference));
+    c.clear();
+    assert(! values.modify(2, [](double & value) noexcept { value = 0.0; }));
+    assert(values.contains(1) && ! values.contains(2));
+    assert(c.is_pure());
+    assert(std::isinf(values.at(1)));
+    assert(c.kind() == kind::exception);
+    c.clear();
+    values.insert_or_assign(1, 3.0);
+    values.transform([](int const key, double const value) noexcept {
+        return value + key;
+    });
+    assert(values.at(1) == 4.0);
+    assert(c.kind() == (kind::exception | kind::reference));
+    assert(c.valid());
+    c.clear();
+    // a callable that may throw
+    assert(values.modify(1, [](double & value) { value += 0.0; }));
+    assert(c.kind() == (kind::exception | kind::reference));
+    c.clear();
+    values.transform([](int const, double const value) { return value; });
+    assert(c.kind() == (kind::exception | kind::reference));
+    c.clear();
+    assert(values.erase(1) == 1 && values.empty());
+    std::map<int, double> const released = std::move(values).release();
+    assert(released.empty());
+    assert(c.is_pure());
+}
+
+bool site_reciprocal(double const x, double & result)
+{
+    EFFECTS_FUNCTION(c, kind::reference | kind::fpe);
+    bool const stable = c_site_summary.stable();
+    region<double> value = c(1.0 / x);
+    result = value;
+    assert(c.valid());
+    return stable;
+}
+
+void test_report()
+{
+    char const * const path = "tests_report.effects";
+    std::uint64_t const site1 = EFFECTS_REPORT_SITE;
+    std::uint64_t const site2 = EFFECTS_REPORT_SITE;
+    assert(site1 != site2);
+    {
+        report::writer w(path, 1024);
+        assert(w.valid());
+        std::vector<std::thread> threads;
+        for (int t = 0; t < 4; ++t)
+        {
+            threads.emplace_back([&w, site1, site2]() {
+                report::buffer b(w);
+                context c(kind::reference | kind::fpe,
+                          context_type::terminating);
+                for (int count = 0; count < 100; ++count)
+                {
+                    // repeated records are coalesced
+                    b.add(site1, kind::pure);
+                }
+                volatile double zero = 0.0;
+                region<double> value = c(1.0 / zero);
+                b.add(site2, c);
+            });
+        }
+        for (std::thread & thread : threads)
+        {
+            thread.join();
+        }
+        assert(w.dropped() == 0);
+    }
+    std::vector<report::record> records;
+    assert(report::read(path, records));
+    assert(records.size() == 4 * 2);
+    std::uint32_t count1 = 0;
+    for (report::record const & value : records)
+    {
+        if (value.site == site1)
+        {
+            assert(value.kind == kind::pure);
+            assert(value.timestamp_first <= value.timestamp_last);
+            count1 += value.count;
+        }
+        else
+        {
+            assert(value.site == site2);
+            assert(value.kind == (kind_fpe::divide_by_zero |
+                                  kind::fpe | kind::reference));
+            assert(value.count == 1);
+        }
+    }
+    assert(count1 == 4 * 100);
+    // records are dropped when the file is full
+    {
+        report::writer w(path, 1);
+        report::buffer b(w);
+        b.add(site1, kind::pure);
+        b.add(site2, kind::pure);
+        b.flush();
+        assert(w.dropped() == 2);
+    }
+    records.clear();
+    assert(report::read(path, records));
+    assert(records.empty());
+    std::remove(path);
+}
+
+void test_site()
+{
+    double result = 0.0;
+    std::size_t count_eager = 0;
+    for (std::size_t count = 0; count < 100; ++count)
+    {
+        if (! site_reciprocal(3.0, result))
+        {
+            ++count_eager;
+        }
+        assert(result == 1.0 / 3.0);
+    }
+    // stable after the first call and site_summary::stable_calls calls
+    assert(count_eager == 1 + site_summary::stable_calls);
+    // new effects make the call site unstable
+    assert(site_reciprocal(0.0, result));
+    assert(! site_reciprocal(3.0, result));
+}
+
+void test_sampled()
+{
+    std::uint64_t const tracked = telemetry.tracked;
+    std::uint64_t const checked = telemetry.checked;
+    std::uint64_t const invalid = telemetry.invalid;
+    std::uint64_t const invalid_divide_by_zero = telemetry.invalid_kind[10];
+    volatile double zero = 0.0;
+    // a rate of 1 tracks all contexts
+    context c1 = context::sampled(kind::reference, context_type::terminating,
+                                  1);
+    assert(c1.tracked());
+    region<double> value1 = c1(1.0 / zero);
+    assert(! c1.valid());
+    assert(! c1.valid());
+    assert(telemetry.tracked == tracked + 1);
+    assert(telemetry.checked == checked + 1);
+    assert(telemetry.invalid == invalid + 1);
+    assert(telemetry.invalid_kind[4] > 0);
+    assert(telemetry.invalid_kind[10] == invalid_divide_by_zero + 1);
+    // reported again after a clear
+    c1.clear();
+    region<double> value1_cleared = c1(1.0 / zero);
+    assert(! c1.valid());
+    assert(telemetry.checked == checked + 2);
+    assert(telemetry.invalid == invalid + 2);
+    // untracked contexts only have value wrappers
+    std::size_t untracked = 0;
+    for (std::size_t count = 0; count < 100; ++count)
+    {
+        context c2 = context::sampled(
+            kind::reference, context_type::terminating,
+            std::numeric_limits<std::uint32_t>::max());
+        if (! c2.tracked())
+        {
+            ++untracked;
+            region<double> value2 = c2(1.0 / zero);
+            region<int *> p_value = c2(&i);
+            assert(std::isinf(value2) && p_value == &i);
+            assert(c2.is_pure());
+            assert(c2.valid());
+            // the FE_* flags are not cleared by an untracked context
+            c2.clear();
+            assert(std::fetestexcept(FE_DIVBYZERO) != 0);
+        }
+    }
+    assert(untracked >= 99);
+    std::feclearexcept(FE_ALL_EXCEPT);
+}
+
+int guarded_parse(int const value)
+{
+    if (value < 0)
+    {
+        throw std::invalid_argument("negative");
+    }
+    return value;
+}
+
+void test_guarded()
+{
+    context c(kind::exception, context_type::terminating);
+    int const value1 = guarded(c, []() noexcept { return 1; });
+    assert(value1 == 1);
+    int const value2 = guarded(c, []() { return guarded_parse(2); });
+    assert(value2 == 2);
+    assert(c.is_pure());
+    bool caught = false;
+    try
+    {
+        int const value3 = guarded(c, []() { return guarded_parse(-1); });
+        assert(value3 == -1);
+    }
+    catch (std::invalid_argument const &)
+    {
+        caught = true;
+    }
+    assert(caught);
+    assert(c.kind() == kind::exception);
+    assert(c.valid());
+    c.clear();
+#if defined(EFFECTS_EXCEPTION_INTERPOSER_ENABLED)
+    {
+        // exceptions thrown by the C++ runtime are recorded
+        current_context scope(c);
+        std::vector<int> const empty;
+        bool thrown = false;
+        try
+        {
+            // not in an assert, so it also throws with NDEBUG
+            int const value = empty.at(1);
+            static_cast<void>(value);
+        }
+        catch (std::out_of_range const &)
+        {
+            thrown = true;
+        }
+        assert(thrown);
+        assert(c.kind() == kind::exception);
+    }
+    c.clear();
+    // not tracked without a current_context object
+    try
+    {
+        throw 1;
+    }
+    catch (int)
+    {
+    }
+    assert(c.is_pure());
+#endif
+}
+
+void test_dispatch()
+{
+    context c(kind::reference | kind::fpe, context_type::terminating);
+    volatile double divisor = 3.0;
+    int safe_calls = 0;
+    auto reciprocal_fast = [&divisor]() {
+        return 1.0 / divisor;
+    };
+    auto reciprocal_safe = [&divisor, &safe_calls]() {
+        ++safe_calls;
+        double const x = divisor;
+        return x == 0.0 ? 0.0 : 1.0 / x;
+    };
+    // the inexact FPE is allowed
+    region<double> value1 = c.dispatch(reciprocal_fast, reciprocal_safe,
+                                       kind_fpe::inexact);
+    assert(value1 == 1.0 / 3.0);
+    assert(safe_calls == 0);
+    assert(c.kind() == (kind_fpe::inexact | kind::fpe | kind::reference));
+    c.clear();
+    // the divide_by_zero FPE is not allowed
+    divisor = 0.0;
+    region<double> value2 = c.dispatch(reciprocal_fast, reciprocal_safe,
+                                       kind_fpe::inexact);
+    assert(value2 == 0.0);
+    assert(safe_calls == 1);
+#if defined(EFFECTS_STATISTICS)
+    assert(c.statistics().dispatch_fallbacks == 1);
+#endif
+    assert(c.kind() == kind::reference);
+    assert(c.valid());
+}
+
+void test_lazy()
+{
+    context c(kind::reference | kind::fpe, context_type::terminating);
+    int calls = 0;
+    volatile double zero = 0.0;
+    auto value = c.lazy([&calls, &zero]() {
+        ++calls;
+        return 1.0 / zero;
+    });
+    auto value_unused = c.lazy([&calls]() {
+        ++calls;
+        return 2;
+    });
+    // nothing is computed or tracked before the value is used
+    assert(! value.forced() && ! value_unused.forced());
+    assert(calls == 0);
+    assert(c.is_pure());
+    double const result = value;
+    assert(std::isinf(result));
+    assert(value.forced());
+    assert(c.kind() == 0x0414);
+    assert(c.kind() == (kind_fpe::divide_by_zero |
+                        kind::fpe | kind::reference));
+    assert(std::isinf(value.get()));
+    assert(calls == 1);
+    assert(c.valid());
+}
+
+#if defined(TESTS_COROUTINES)
+// resume the coroutine in a new thread
+struct resume_thread
+{
+    std::vector<std::thread> & threads;
+    bool await_ready() const noexcept
+    {
+        return false;
+    }
+    void await_suspend(std::coroutine_handle<> h) const
+    {
+        threads.emplace_back([h]() { h.resume(); });
+    }
+    void await_resume() const noexcept
+    {
+    }
+};
+
+task<double> divide(context & c, std::vector<std::thread> & threads,
+                    double const x)
+{
+    co_await resume_thread{threads};
+    // the context is attached in the thread that resumed the coroutine
+    assert(current_context::get() == &c);
+    volatile double divisor = x;
+    co_return c(1.0 / divisor);
+}
+
+task<void> handler(context & c, std::vector<std::thread> & threads)
+{
+    double const value = co_await divide(c, threads, 0.0);
+    assert(std::isinf(value));
+    co_await resume_thread{threads};
+    // the FPE were sampled in the thread that resumed the coroutine
+    assert(c.kind() == (kind_fpe::divide_by_zero |
+                        kind::fpe | kind::reference));
+}
+
+void test_coroutine()
+{
+    context c(kind::reference | kind::fpe, context_type::terminating);
+    std::vector<std::thread> threads;
+    // FE_* flags of the waiting thread are not FPE of the coroutine
+    volatile double value_inexact = opaque(2.0) / 3.0;
+    handler(c, threads).get();
+    assert(c.kind() == (kind_fpe::divide_by_zero |
+                        kind::fpe | kind::reference));
+    for (std::thread & thread : threads)
+    {
+        thread.join();
+    }
+    assert(threads.size() == 2);
+    assert(std::fetestexcept(FE_ALL_EXCEPT) == FE_INEXACT);
+    assert(c.valid());
+    c.clear();
+    static_cast<void>(value_inexact);
+}
+#endif
+
+void test_memoize()
+{
+    context c(kind::reference, context_type::terminating);
+    int calls = 0;
+    auto square = memoize<int>([&calls](context & c_f, int const x) {
+        ++calls;
+        region<int> value = c_f(x * x);
+        return static_cast<int>(value);
+    });
+    assert(square(c, 3) == 9);
+    assert(square(c, 3) == 9);
+    assert(calls == 1);
+    assert(square.hits() == 1 && square.misses() == 1);
+    assert(c.is_pure());
+    // impure results are never cached
+    auto reference = memoize<int>([&calls](context & c_f, int const x) {
+        ++calls;
+        region<int &> i_reference = c_f(i);
+        return x + i_reference;
+    });
+    assert(reference(c, 1) == 1 + i);
+    assert(reference(c, 1) == 1 + i);
+    assert(calls == 3);
+    assert(c.kind() == kind::reference);
+    c.clear();
+    // cacheable effects are merged for a cached result
+    auto fpe = memoize<double>([](context & c_f, double const x) {
+        region<double> value = c_f(1.0 / x);
+        return static_cast<double>(value);
+    }, kind::reference | kind::fpe);
+    assert(std::isinf(fpe(c, 0.0)));
+    c.clear();
+    assert(std::isinf(fpe(c, 0.0)));
+    assert(fpe.hits() == 1);
+    assert(c.kind() == (kind_fpe::divide_by_zero |
+                        kind::fpe | kind::reference));
+    c.clear();
+    // FPE without a region are not cacheable
+    auto fpe_temporary = memoize<double>([](context &, double const x) {
+        volatile double temporary = 1.0 / x;
+        static_cast<void>(temporary);
+        return 0.0;
+    }, kind::reference);
+    assert(fpe_temporary(c, 0.0) == 0.0);
+    assert(fpe_temporary(c, 0.0) == 0.0);
+    assert(fpe_temporary.hits() == 0);
+    assert(c.kind() == (kind_fpe::divide_by_zero | kind::fpe));
+    c.clear();
+    // the capacity is bounded with older results evicted
+    auto add = memoize<int, int>([](context &, int const x, int const y) {
+        return x + y;
+    }, kind::pure, 16);
+    assert(add.capacity() == 16);
+    for (int x = 0; x < 1000; ++x)
+    {
+        assert(add(c, x, 1) == x + 1);
+    }
+    assert(add.misses() == 1000);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; ++t)
+    {
+        threads.emplace_back([&add]() {
+            context c_thread(kind::pure, context_type::terminating);
+            for (int x = 0; x < 1000; ++x)
+            {
+                assert(add(c_thread, x % 16, 2) == x % 16 + 2);
+            }
+            assert(c_thread.valid());
+        });
+    }
+    for (std::thread & thread : threads)
+    {
+        thread.join();
+    }
+    assert(add.hits() + add.misses() == 1000 + 4 * 1000);
+    assert(add.hits() > 0);
+    assert(c.valid());
+}
+
+void test_static_context()
+{
+    // type-derived effects are checked at compile time
+    using context_fpe = static_context<kind::reference | kind::fpe>;
+    context_fpe c;
+    region<double, context_fpe> value_invalid = c(opaque(0.0) / 0.0);
+    region<int &, context_fpe> i_reference = c(i);
+    region<int const &, context_fpe> j_constant = c(j);
+    assert(i_reference + j_constant == 4);
+    // valid effects are not tracked at runtime
+    assert(c.kind() == kind::pure);
+    assert(c.valid());
+    using context_reference = static_context<kind::reference>;
+    context_reference c_fpe_invalid;
+    region<double, context_reference> value_divide_by_zero =
+        c_fpe_invalid(opaque(1.0) / 0.0);
+    assert(c_fpe_invalid.kind() == 0x0410);
+    assert(c_fpe_invalid.kind() == (kind_fpe::divide_by_zero | kind::fpe));
+    assert(! c_fpe_invalid.valid());
+    c_fpe_invalid.clear();
+    assert(c_fpe_invalid.valid());
+    using context_pure = static_context<kind::pure>;
+    context_pure c_pure;
+    region<int, context_pure> value = c_pure(3);
+    region<int *, context_pure> p1_value = c_pure(static_cast<int *>(0));
+    assert(c_pure.valid());
+    region<int *, context_pure> p2_value = c_pure(new int(1));
+    assert(c_pure.kind() == kind::write);
+    assert(! c_pure.valid());
+    delete p2_value;
+    c_pure.clear();
+    c_pure.set_exception();
+    assert(! c_pure.valid());
+}
+
+void test_bulk()
+{
+    context c(kind::reference | kind::fpe, context_type::terminating);
+    std::vector<double> values = {1.0, 2.0, 4.0, 8.0};
+    region_span<double> span = c.span(values);
+    assert(c.kind() == kind::reference);
+    span.transform([](double const x) { return x * 0.5; });
+    assert(c.kind() == kind::reference);
+    assert(span[3] == 4.0);
+    region<double> sum =
+        span.reduce(0.0, [](double const x, double const y) {
+            return x + y;
+        });
+    assert(sum == 7.5);
+    assert(c.kind() == kind::reference);
+    span.assign(0.0);
+    span.transform([](double const x) { return 1.0 / x; });
+    assert(c.kind() == 0x0414);
+    assert(c.kind() ==
+           (kind_fpe::divide_by_zero | kind::fpe | kind::reference));
+    assert(values[0] == std::numeric_limits<double>::infinity());
+    assert(c.valid());
+    c.clear();
+    region_array<int, 4> integers = c.array(std::array<int, 4>{1, 2, 3, 4});
+    assert(c.is_pure());
+    std::vector<int> const integers_input = {5, 6, 7, 8};
+    integers.assign(integers_input.begin());
+    assert(integers[3] == 8);
+    integers.assign(2);
+    region<int> product =
+        integers.reduce(1, [](int const x, int const y) {
+            return x * y;
+        });
+    assert(product == 16);
+    assert(c.is_pure());
+    int * const pointers[2] = {nullptr, new int(1)};
+    region_span<int * const> owned = c.span(pointers, 2);
+    assert(c.kind() == (kind::reference | kind::write));
+    delete pointers[1];
+    assert(! c.valid());
+}
+
+#if defined(__GNUC__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wignored-attributes"
+#endif
+void test_simd()
+{
+    context c(kind::reference | kind::fpe, context_type::terminating);
+#if defined(__SSE2__)
+    static_assert(is_floating_point<__m128d>::value);
+    static_assert(is_floating_point<__m128d *>::value);
+    static_assert(! is_floating_point<__m128i>::value);
+    __m128d const zeros = opaque(_mm_set1_pd(0.0));
+    __m128d const dividends = _mm_set_pd(1.0, 0.0);
+    // one lane divide_by_zero, one lane invalid
+    region<__m128d> value = c(_mm_div_pd(dividends, zeros));
+    assert(c.kind() == 0x0514);
+    assert(c.kind() ==
+           (kind_fpe::invalid | kind_fpe::divide_by_zero |
+            kind::fpe | kind::reference));
+    assert(c.valid());
+    c.clear();
+#endif
+#if __has_include(<experimental/simd>)
+    namespace stdx = std::experimental;
+    static_assert(is_floating_point< stdx::native_simd<double> >::value);
+    static_assert(! is_floating_point< stdx::native_simd<int> >::value);
+    stdx::native_simd<double> const dividends_simd = opaque(1.0);
+    region< stdx::native_simd<double> > value_simd =
+        c(dividends_simd / stdx::native_simd<double>(0.0));
+    assert(c.kind() == 0x0414);
+    assert(c.kind() ==
+           (kind_fpe::divide_by_zero | kind::fpe | kind::reference));
+    assert(c.valid());
+    c.clear();
+#endif
+    region<int> value_integer = c(1);
+    assert(c.is_pure());
+}
+#if defined(__GNUC__)
+#pragma GCC diagnostic pop
+#endif
+
+void test_shared_context()
+{
+    shared_context c(kind::reference | kind::fpe, context_type::terminating);
+    std::vector<std::thread> threads;
+    for (int thread_i = 0; thread_i < 4; ++thread_i)
+    {
+        threads.emplace_back([&c, thread_i]() {
+            shared_context::shard c_thread(c);
+            region<int const &> value = c_thread(thread_i);
+            if (thread_i == 2)
+            {
+                region<double> value_invalid = c_thread(opaque(0.0) / 0.0);
+            }
+            else if (thread_i == 3)
+            {
+                region<int &> i_reference = c_thread(i);
+            }
+        });
+    }
+    for (std::thread & t : threads)
+    {
+        t.join();
+    }
+    assert(c.kind() == 0x0114);
+    assert(c.kind() ==
+           (kind_fpe::invalid | kind::fpe | kind::reference));
+    assert(c.has_fpe());
+    assert(c.valid());
+    c.clear();
+    assert(c.is_pure());
+    std::thread([&c]() {
+        shared_context::shard c_thread(c, fpe_sampling::deferred);
+        region<int *> p_value = c_thread(new int(1));
+        delete p_value;
+        c_thread.join();
+        assert(! c.valid());
+    }).join();
+    assert(c.kind() == kind::write);
+    assert(! c.valid());
+}
+
+void test_parallel()
+{
+    context c(kind::reference | kind::fpe, context_type::terminating);
+    std::vector<double> values(4096, 2.0);
+    values[1000] = 0.0;
+    par::for_each(c, std::execution::par, values.begin(), values.end(),
+                  [](double & x) { x *= 0.5; });
+    assert(c.kind() == kind::reference);
+    std::vector<double> results(values.size());
+    par::transform(c, std::execution::par_unseq,
+                   values.begin(), values.end(), results.begin(),
+                   [](double const x) { return 1.0 / x; });
+    assert(results[0] == 1.0);
+    assert(results[1000] == std::numeric_limits<double>::infinity());
+    assert(c.kind() == 0x0414);
+    assert(c.kind() ==
+           (kind_fpe::divide_by_zero | kind::fpe | kind::reference));
+    assert(c.valid());
+    c.clear();
+    region<double> sum = par::reduce(c, std::execution::par,
+                                     values.begin(), values.end(), 0.0);
+    assert(sum == 4095.0);
+    assert(c.kind() == kind::reference);
+    std::vector<int> integers(1000, 1);
+    region<int> product =
+        par::reduce(c, std::execution::seq, integers.begin(), integers.end(),
+                    1, [](int const x, int const y) { return x * y; });
+    assert(product == 1);
+    // the context of the chunk may be used for regions
+    par::for_each(c, std::execution::par, integers.begin(), integers.end(),
+                  [](context & c_chunk, int & x) {
+        region<int *> p_value = c_chunk(x == 0 ? nullptr : &x);
+    });
+    assert(c.kind() == (kind::reference | kind::write));
+    assert(! c.valid());
+}
+
+#if defined(EFFECTS_TRACE)
+void test_trace()
+{
+    context c(kind::reference | kind::fpe, context_type::terminating);
+    region<int> value = c(1);
+    assert(c.trace().size() == 0);
+    unsigned int const line_invalid = __LINE__ + 1;
+    region<double> value_invalid = c(opaque(0.0) / 0.0);
+    region<double> value_divide_by_zero = c(opaque(1.0) / 0.0);
+    trace_log const & log = c.trace();
+    assert(log.size() == 4);
+    assert(log.dropped() == 0);
+    assert(log[0].kind == kind::reference);
+    assert(log[1].kind == kind::fpe);
+    assert(log[2].kind == kind_fpe::invalid);
+    assert(log[3].kind == kind_fpe::divide_by_zero);
+    assert(log[0].location.line() == line_invalid);
+    assert(log[2].location.line() == line_invalid);
+    assert(log[3].location.line() == line_invalid + 1);
+    assert(std::strcmp(log[0].location.file_name(), __FILE__) == 0);
+    assert(log[0].timestamp == log[2].timestamp);
+    assert(log[2].timestamp <= log[3].timestamp);
+    // the log is a ring buffer preserved when the context is cleared
+    for (std::size_t k = 0; k < trace_log::capacity; ++k)
+    {
+        c.clear();
+        region<double> value_overflow =
+            c(opaque(std::numeric_limits<double>::max()) * 2.0);
+    }
+    assert(log.size() == trace_log::capacity);
+    assert(log.dropped() == 4 + 4 * trace_log::capacity - log.size());
+    assert(log[log.size() - 4].kind == kind::reference);
+    assert(log[log.size() - 3].kind == kind::fpe);
+    assert(log[log.size() - 2].kind == kind_fpe::overflow);
+    assert(log[log.size() - 1].kind == kind_fpe::inexact);
+    assert(c.valid());
+    // the caller location is traced for a value allocated in an arena
+    context c_alloc(kind::reference, context_type::terminating);
+    alignas(double) unsigned char buffer[sizeof(double)];
+    arena a(c_alloc, buffer, sizeof(buffer));
+    unsigned int const line_alloc = __LINE__ + 2;
+    region<double *> p_value =
+        c_alloc.alloc_at<double>(trace_location::current(), 1.5);
+    assert(c_alloc.trace().size() == 1);
+    assert(c_alloc.trace()[0].location.line() == line_alloc);
+    // the caller location is traced for a value constructed in-place
+    context c_make(kind::reference | kind::fpe, context_type::terminating);
+    unsigned int const line_make = __LINE__ + 2;
+    region<double> value_made =
+        c_make.make_at<double>(trace_location::current(), opaque(0.0) / 0.0);
+    {
+        current_context scope(c_make);
+        region<double, current_context> value_scope =
+            scope.make_at<double>(trace_location::current(),
+                                  opaque(1.0) / 0.0);
+    }
+    trace_log const & log_make = c_make.trace();
+    assert(log_make.size() == 4);
+    assert(log_make[0].location.line() == line_make);
+    assert(log_make[3].location.line() == line_make + 4);
+}
+#endif
+
+#if defined(EFFECTS_STATISTICS)
+void test_statistics()
+{
+    context c(kind::reference | kind::fpe, context_type::terminating);
+    region<int> value = c(1);
+    region<int const &> j_constant = c(j);
+    region<int &> i_reference = c(i);
+    region<double> value_exact = c(0.5);
+    value_exact = 1.5;
+    value = 2;
+    region<double> value_invalid = c(opaque(0.0) / 0.0);
+    assert(c.valid());
+    context_statistics const statistics = c.statistics();
+    assert(statistics.values == 3);
+    assert(statistics.constants == 1);
+    assert(statistics.references == 1);
+    assert(statistics.assignments == 2);
+    // 3 floating-point regions and valid
+    assert(statistics.fpe_reads == 4);
+    assert(statistics.fpe_reads_set == 1);
+    // the constructor and the FE_* flags set
+    assert(statistics.fpe_clears == 2);
+    c.clear();
+    assert(c.statistics().fpe_clears == 3);
+    std::vector<double> values(4, 1.0);
+    region_span<double> span = c.span(values);
+    span.transform([](double const x) { return x * 2.0; });
+    assert(c.statistics().references == 2);
+    assert(c.statistics().assignments == 3);
+    assert(c.statistics().fpe_reads == 6);
+}
+#endif
+
+static_assert(alignof(shared_context::shard) == cache_line_size);
+static_assert(sizeof(region<double, current_context>) == sizeof(double));
+static_assert(sizeof(region<int, current_context>) == sizeof(int));
+static_assert(std::is_trivially_copyable_v<region<double, current_context>>);
+static_assert(std::is_trivially_copyable_v<region<int, current_context>>);
+static_assert(std::is_trivially_copyable_v<region<int &, current_context>>);
+static_assert(std::is_trivially_copyable_v<
+    region<int const &, current_context>>);
+
+void test_current_context()
+{
+    assert(current_context::get() == nullptr);
+    {
+        // a region that outlives its current_context scope is not tracked
+        context c_scoped(kind::pure, context_type::terminating);
+        std::optional< region<double, current_context> > outlived;
+        {
+            current_context scope_outlived(c_scoped);
+            outlived.emplace(scope_outlived(1.0));
+        }
+        c_scoped.clear();
+        assert(current_context::get() == nullptr);
+        *outlived = 2.0;
+        assert(*outlived == 2.0);
+        assert(c_scoped.is_pure());
+    }
+    context c(kind::reference | kind::fpe, context_type::terminating);
+    current_context scope(c);
+    assert(current_context::get() == &c);
+    region<double, current_context> values[2] = {scope(1.0),
+                                                 scope(opaque(0.0) / 0.0)};
+    assert(c.kind() == 0x0114);
+    assert(c.kind() ==
+           (kind_fpe::invalid | kind::fpe | kind::reference));
+    assert(c.valid());
+    c.clear();
+    {
+        context c_nested(kind::pure, context_type::terminating);
+        current_context scope_nested(c_nested);
+        assert(current_context::get() == &c_nested);
+        region<int, current_context> value = scope_nested(1);
+        values[0] = values[1];
+        assert(c_nested.valid());
+        region<int &, current_context> i_reference = scope_nested(i);
+        assert(c_nested.kind() == kind::reference);
+        assert(! c_nested.valid());
+    }
+    assert(current_context::get() == &c);
+    values[1] = 2.0;
+    assert(values[1] == 2.0);
+    assert(c.kind() == kind::reference);
+    assert(c.valid());
+}
+
 int main(int, char **)
 {
     test_integers();
     test_fpe();
+    test_fpe_deferred();
+    test_fpe_policy();
+    test_fpe_trap();
     test_pointers();
+    test_memory();
+    test_environment();
+    test_move();
+    test_child_context();
+    test_arena();
+    test_region_vector();
+    test_region_map();
+    test_report();
+    test_site();
+    test_sampled();
+    test_dispatch();
+    test_guarded();
+    test_lazy();
+    test_memoize();
+#if defined(TESTS_COROUTINES)
+    test_coroutine();
+#endif
+    test_static_context();
+    test_current_context();
+    test_bulk();
+    test_simd();
+    test_shared_context();
+    test_parallel();
+#if defined(EFFECTS_TRACE)
+    test_trace();
+#endif
+#if defined(EFFECTS_STATISTICS)
+    test_statistics();
+#endif
 
     std::cout << "ALL TESTS PASSED" << std::endl;
     return 0;